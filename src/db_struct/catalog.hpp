@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "allocator.hpp"
+#include "class.hpp"
+
+namespace db {
+
+// Everything the class cache needs from the class header
+struct CatalogEntry {
+    ts::Fingerprint fingerprint_;
+    mem::PageIndex index_;
+    mem::Magic magic_;
+    size_t id_;
+};
+
+static_assert(std::is_trivially_copyable_v<CatalogEntry> &&
+              sizeof(CatalogEntry) == 4 * sizeof(uint64_t));
+
+// Copy of the class headers written when the catalog is closed, so it's opened by reading the
+// snapshot pages instead of every header. The checksum is zeroed before any change of the headers,
+// so the snapshot left by a crash isn't trusted
+class CatalogSnapshot {
+    DECLARE_LOGGER;
+    mem::PageAllocator::Ptr alloc_;
+    mem::PageList page_list_;
+    std::atomic<bool> stale_ = false;
+
+    struct Header {
+        ts::Fingerprint checksum_;
+        size_t count_;
+    };
+
+    [[nodiscard]] static ts::Fingerprint Checksum(const char* entries, size_t count) {
+        return ts::FingerprintOf(std::string_view(entries, count * sizeof(CatalogEntry)));
+    }
+
+    void Drop() {
+        while (!page_list_.IsEmpty()) {
+            auto index = page_list_.Back();
+            page_list_.PopBack();
+            alloc_->FreePage(index);
+        }
+    }
+
+public:
+    CatalogSnapshot(mem::PageAllocator::Ptr& alloc, mem::Offset sentinel_offset,
+                    DEFAULT_LOGGER(logger))
+        : LOGGER(logger),
+          alloc_(alloc),
+          page_list_("Catalog", alloc_->GetFile(), sentinel_offset, LOGGER) {
+    }
+
+    [[nodiscard]] bool IsStale() const {
+        return stale_;
+    }
+
+    // Entries are returned only if the snapshot is intact and lists all the classes
+    [[nodiscard]] std::optional<std::vector<CatalogEntry>> Read(size_t classes_count) {
+        if (stale_ || page_list_.IsEmpty()) {
+            return std::nullopt;
+        }
+        auto& file = alloc_->GetFile();
+        std::vector<char> buffer;
+        for (auto& page : page_list_) {
+            auto chunk = file->ReadVector<char>(
+                mem::GetOffset(page.index_, sizeof(mem::Page), file), page.actual_size_);
+            buffer.insert(buffer.end(), chunk.begin(), chunk.end());
+        }
+
+        Header header;
+        if (buffer.size() < sizeof(Header)) {
+            return std::nullopt;
+        }
+        std::memcpy(&header, buffer.data(), sizeof(Header));
+        auto entries_data = buffer.data() + sizeof(Header);
+        if (header.count_ != classes_count ||
+            buffer.size() != sizeof(Header) + header.count_ * sizeof(CatalogEntry) ||
+            header.checksum_ != Checksum(entries_data, header.count_)) {
+            WARN("Catalog snapshot is invalid");
+            return std::nullopt;
+        }
+
+        std::vector<CatalogEntry> entries(header.count_);
+        std::memcpy(entries.data(), entries_data, header.count_ * sizeof(CatalogEntry));
+        return entries;
+    }
+
+    void Write(const std::vector<CatalogEntry>& entries) {
+        Drop();
+        auto entries_data = reinterpret_cast<const char*>(entries.data());
+        auto header = Header{Checksum(entries_data, entries.size()), entries.size()};
+        std::vector<char> buffer(sizeof(Header) + entries.size() * sizeof(CatalogEntry));
+        std::memcpy(buffer.data(), &header, sizeof(Header));
+        std::memcpy(buffer.data() + sizeof(Header), entries_data,
+                    entries.size() * sizeof(CatalogEntry));
+
+        auto& file = alloc_->GetFile();
+        auto capacity = alloc_->GetPageSize() - sizeof(mem::Page);
+        for (size_t written = 0; written < buffer.size(); written += capacity) {
+            auto chunk_size = std::min(capacity, buffer.size() - written);
+            page_list_.PushBack(alloc_->AllocatePage());
+            auto page = mem::ReadPage(mem::Page(page_list_.Back()), file);
+            page.type_ = mem::PageType::kCatalog;
+            page.free_offset_ = static_cast<mem::PageOffset>(sizeof(mem::Page) + chunk_size);
+            page.actual_size_ = chunk_size;
+            mem::WritePage(page, file);
+            file->Write(buffer, mem::GetOffset(page.index_, sizeof(mem::Page), file), written,
+                        chunk_size);
+        }
+        stale_ = false;
+        DEBUG("Catalog pages: ", page_list_.GetPagesCount());
+    }
+
+    // Only the first change after the snapshot is read or written touches the file
+    void MarkStale() {
+        if (stale_.exchange(true) || page_list_.IsEmpty()) {
+            return;
+        }
+        auto& file = alloc_->GetFile();
+        file->Write<ts::Fingerprint>(0,
+                                     mem::GetOffset(page_list_.Front(), sizeof(mem::Page), file));
+    }
+};
+
+}  // namespace db
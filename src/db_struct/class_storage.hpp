@@ -1,9 +1,16 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "allocator.hpp"
+#include "catalog.hpp"
 #include "class_object.hpp"
 
 namespace db {
@@ -15,26 +22,60 @@ private:
     DECLARE_LOGGER;
     mem::PageAllocator::Ptr alloc_;
     mem::PageList class_list_;
+    CatalogSnapshot catalog_;
 
-    using ClassCache = std::unordered_map<std::string, mem::PageIndex>;
+    // Classes are found by their fingerprints, collisions of 64-bit hashes are not expected
+    using ClassCache = std::unordered_map<ts::Fingerprint, mem::PageIndex>;
     ClassCache class_cache_;
 
-    std::string GetSerializedClass(mem::PageIndex index) const {
-        auto header = mem::ClassHeader(index).ReadClassHeader(alloc_->GetFile());
-        ts::ClassObject class_object;
-        class_object.Read(alloc_->GetFile(), mem::GetOffset(header.index_, header.free_offset_));
-        return class_object.ToString();
+    // Ids are leased from the class header by ranges, only the end of the range is written, so
+    // ids that weren't given before the database is closed are skipped
+    static constexpr size_t kIdLeaseSize = 4096;
+
+    struct IdLease {
+        std::atomic<size_t> next_;
+        std::atomic<size_t> end_;
+        std::mutex mutex_;
+    };
+    // Leases are created with the cache entries, so the map isn't changed while ids are given.
+    // Magic is the key since it's kept when the header is moved by compaction
+    std::unordered_map<mem::Magic, std::unique_ptr<IdLease>> id_leases_;
+
+    void AddLease(mem::Magic magic, size_t id) {
+        if (id_leases_.contains(magic)) {
+            return;
+        }
+        auto lease = std::make_unique<IdLease>();
+        lease->next_ = id;
+        lease->end_ = id;
+        id_leases_.emplace(magic, std::move(lease));
     }
 
+    ts::Fingerprint GetFingerprint(mem::PageIndex index) const {
+        return mem::ClassHeader(index).ReadClassHeader(alloc_->GetFile()).fingerprint_;
+    }
+
+    // Only the snapshot or the headers are read, classes are parsed when they are visited
     void InitializeClassCache() {
         INFO("Initializing class cache..");
 
         class_cache_.clear();
 
+        if (auto entries = catalog_.Read(class_list_.GetPagesCount()); entries.has_value()) {
+            for (auto& entry : entries.value()) {
+                class_cache_.emplace(entry.fingerprint_, entry.index_);
+                AddLease(entry.magic_, entry.id_);
+            }
+            INFO("Catalog snapshot loaded");
+            return;
+        }
+
+        catalog_.MarkStale();
         for (auto& class_it : class_list_) {
-            auto serialized = GetSerializedClass(class_it.index_);
-            DEBUG("Initialized:", serialized);
-            class_cache_.emplace(serialized, class_it.index_);
+            auto header = mem::ClassHeader(class_it.index_).ReadClassHeader(alloc_->GetFile());
+            DEBUG("Initialized:", header.fingerprint_);
+            class_cache_.emplace(header.fingerprint_, class_it.index_);
+            AddLease(header.magic_, header.id_);
         }
     }
 
@@ -53,19 +94,76 @@ private:
         return util::MakePtr<ts::ClassObject>(new_class);
     }
 
-    mem::ClassHeader InitializeClassHeader(mem::PageIndex index,
-                                           ts::ClassObject::Ptr& class_object) {
+    mem::ClassHeader InitializeClassHeader(mem::PageIndex index, ts::ClassObject::Ptr& class_object,
+                                           mem::NodeLayout layout) {
         return mem::ClassHeader(index)
             .ReadClassHeader(alloc_->GetFile())
             .InitClassHeader(alloc_->GetFile(), class_object->Size())
-            .WriteMagic(alloc_->GetFile(), rand());
+            .WriteMagic(alloc_->GetFile(), rand())
+            .WriteLayout(alloc_->GetFile(), layout)
+            .WriteFingerprint(alloc_->GetFile(), class_object->GetClass()->GetFingerprint());
+    }
+
+    [[nodiscard]] size_t InlineCapacity() const {
+        return alloc_->GetPageSize() - sizeof(mem::ClassHeader);
+    }
+
+    // Class is written into its header page, the part that doesn't fit is chained to the header
+    void WriteClass(mem::ClassHeader& header, const ts::ClassObject& class_object) {
+        auto& file = alloc_->GetFile();
+        std::vector<char> buffer(class_object.Size());
+        class_object.Write(buffer.data());
+        auto inline_size = std::min(buffer.size(), InlineCapacity());
+        file->WriteBuffer(buffer.data(), mem::GetOffset(header.index_, header.free_offset_, file),
+                          inline_size);
+
+        auto overflow = mem::PageList("Class_Overflow", file,
+                                      header.GetClassOverflowSentinelOffset(file), LOGGER);
+        auto capacity = alloc_->GetPageSize() - sizeof(mem::Page);
+        for (auto written = inline_size; written < buffer.size(); written += capacity) {
+            auto chunk_size = std::min(capacity, buffer.size() - written);
+            overflow.PushBack(alloc_->AllocatePage());
+            auto page = mem::ReadPage(mem::Page(overflow.Back()), file);
+            page.type_ = mem::PageType::kOverflow;
+            page.free_offset_ = static_cast<mem::PageOffset>(sizeof(mem::Page) + chunk_size);
+            page.actual_size_ = chunk_size;
+            mem::WritePage(page, file);
+            file->WriteBuffer(buffer.data() + written,
+                              mem::GetOffset(page.index_, sizeof(mem::Page), file), chunk_size);
+        }
+        if (!overflow.IsEmpty()) {
+            DEBUG("Class overflow pages: ", overflow.GetPagesCount());
+        }
+    }
+
+    void FreeClassOverflow(mem::PageIndex index) {
+        auto& file = alloc_->GetFile();
+        auto overflow = mem::PageList("Class_Overflow", file,
+                                      mem::ClassHeader(index).GetClassOverflowSentinelOffset(file),
+                                      LOGGER);
+        while (!overflow.IsEmpty()) {
+            auto page_index = overflow.Back();
+            overflow.PopBack();
+            alloc_->FreePage(page_index);
+        }
+    }
+
+    void WriteCatalog() {
+        std::vector<CatalogEntry> entries;
+        entries.reserve(class_list_.GetPagesCount());
+        for (auto& class_it : class_list_) {
+            auto header = mem::ClassHeader(class_it.index_).ReadClassHeader(alloc_->GetFile());
+            entries.push_back(
+                CatalogEntry{header.fingerprint_, header.index_, header.magic_, header.id_});
+        }
+        catalog_.Write(entries);
     }
 
 public:
     using Ptr = util::Ptr<ClassStorage>;
 
     ClassStorage(mem::PageAllocator::Ptr& alloc, DEFAULT_LOGGER(logger))
-        : LOGGER(logger), alloc_(alloc) {
+        : LOGGER(logger), alloc_(alloc), catalog_(alloc_, mem::kCatalogSentinelOffset, LOGGER) {
 
         DEBUG("Class list sentinel offset:", mem::kClassListSentinelOffset);
         DEBUG("Class list count:", alloc_->GetFile()->Read<size_t>(
@@ -79,18 +177,36 @@ public:
         InitializeClassCache();
     }
 
+    // The snapshot is written only if the headers were changed since it was read
+    ~ClassStorage() {
+        if (!catalog_.IsStale()) {
+            return;
+        }
+        try {
+            WriteCatalog();
+        } catch (const std::exception& e) {
+            ERROR("Can't write catalog snapshot: ", e.what());
+        }
+    }
+
+    // Class headers could be relocated by compaction, so cached indicies should be reread
+    void ReloadCache() {
+        catalog_.MarkStale();
+        InitializeClassCache();
+    }
+
     template <ts::ClassLike C>
     std::optional<mem::PageIndex> FindClass(util::Ptr<C> new_class,
                                             DataMode mode = DataMode::kCache) {
-        auto class_object = MakeClassHolder(new_class);
-        auto serialized = class_object->ToString();
-        if (class_cache_.contains(serialized)) {
+        auto fingerprint = new_class->GetFingerprint();
+        auto it = class_cache_.find(fingerprint);
+        if (it != class_cache_.end()) {
             switch (mode) {
                 case DataMode::kCache:
-                    return class_cache_[serialized];
+                    return it->second;
                 case DataMode::kFile: {
-                    if (serialized == GetSerializedClass(class_cache_[serialized])) {
-                        return class_cache_[serialized];
+                    if (fingerprint == GetFingerprint(it->second)) {
+                        return it->second;
                     }
                 } break;
             }
@@ -98,7 +214,7 @@ public:
 
         if (mode == DataMode::kFile) {
             for (auto& page : class_list_) {
-                if (GetSerializedClass(page.index_) == serialized) {
+                if (GetFingerprint(page.index_) == fingerprint) {
                     return page.index_;
                 }
             }
@@ -108,13 +224,14 @@ public:
     }
 
     template <ts::ClassLike C>
-    void AddClass(const util::Ptr<C>& new_class) {
+    void AddClass(const util::Ptr<C>& new_class,
+                  mem::NodeLayout layout = mem::NodeLayout::kDefault) {
         INFO("Adding new class..");
 
         auto class_object = MakeClassHolder(new_class);
 
-        if (class_object->Size() > mem::kPageSize - sizeof(mem::ClassHeader)) {
-            throw error::NotImplemented("Too complex class");
+        if (layout == mem::NodeLayout::kCompact && !new_class->Size().has_value()) {
+            throw error::BadArgument("Compact layout is supported only for fixed size classes");
         }
 
         auto index = FindClass(new_class, DataMode::kFile);
@@ -123,16 +240,20 @@ public:
         if (!cache_index.has_value()) {
             DEBUG(class_object->ToString());
             if (!index.has_value()) {
-                auto header = InitializeClassHeader(alloc_->AllocatePage(), class_object);
+                catalog_.MarkStale();
+                auto header =
+                    InitializeClassHeader(alloc_->AllocatePage(), class_object, layout);
                 DEBUG("Index: ", header.index_);
 
                 class_list_.PushBack(header.index_);
-                class_object->Write(alloc_->GetFile(),
-                                    mem::GetOffset(header.index_, header.free_offset_));
-                class_cache_.emplace(class_object->ToString(), header.index_);
+                WriteClass(header, *class_object);
+                class_cache_.emplace(new_class->GetFingerprint(), header.index_);
+                AddLease(header.magic_, header.id_);
             } else {
                 INFO("Adding class to cache");
-                class_cache_.emplace(class_object->ToString(), index.value());
+                class_cache_.emplace(new_class->GetFingerprint(), index.value());
+                auto header = mem::ClassHeader(index.value()).ReadClassHeader(alloc_->GetFile());
+                AddLease(header.magic_, header.id_);
             }
 
         } else {
@@ -167,10 +288,53 @@ public:
             return;
         }
 
+        catalog_.MarkStale();
+        id_leases_.erase(mem::ClassHeader(index.value()).ReadMagic(alloc_->GetFile()).magic_);
         class_list_.Unlink(index.value());
+        FreeClassOverflow(index.value());
         alloc_->FreePage(index.value());
     }
 
+    // Could be called from several threads, the header is written only when the lease is over
+    ts::ObjectId NewNodeId(const mem::ClassHeader& header) {
+        auto& lease = *id_leases_.at(header.magic_);
+        auto id = lease.next_.fetch_add(1);
+        if (id < lease.end_) {
+            return id;
+        }
+
+        std::lock_guard lock(lease.mutex_);
+        if (id >= lease.end_) {
+            auto end = std::max<size_t>(lease.end_, id + 1) + kIdLeaseSize - 1;
+            catalog_.MarkStale();
+            mem::ClassHeader(header.index_).WriteNodeId(alloc_->GetFile(), end);
+            DEBUG("Leased ids up to ", end);
+            lease.end_ = end;
+        }
+        return id;
+    }
+
+    // Header and the inlined part of the class are read at once, so small classes take one read
+    [[nodiscard]] ts::Class::Ptr ReadClass(const mem::Page& class_page) {
+        auto& file = alloc_->GetFile();
+        auto buffer = file->ReadVector<char>(mem::GetPageAddress(class_page.index_, file),
+                                             class_page.initialized_offset_);
+        mem::ClassHeader header;
+        std::memcpy(&header, buffer.data(), sizeof(mem::ClassHeader));
+        if (header.class_overflow_pages_count_ != 0) {
+            auto overflow = mem::PageList("Class_Overflow", file,
+                                          header.GetClassOverflowSentinelOffset(file), LOGGER);
+            for (auto& page : overflow) {
+                auto chunk = file->ReadVector<char>(
+                    mem::GetOffset(page.index_, sizeof(mem::Page), file), page.actual_size_);
+                buffer.insert(buffer.end(), chunk.begin(), chunk.end());
+            }
+        }
+        ts::ClassObject class_object;
+        class_object.Read(buffer.data() + header.free_offset_);
+        return class_object.GetClass();
+    }
+
     template <typename F>
     requires std::invocable<F, mem::ClassHeader>
     void VisitClasses(F functor) {
@@ -183,10 +347,7 @@ public:
     requires std::invocable<Functor, ts::Class::Ptr>
     void VisitClasses(Functor functor) {
         for (auto& class_header : class_list_) {
-            ts::ClassObject class_object;
-            class_object.Read(alloc_->GetFile(),
-                              mem::GetOffset(class_header.index_, class_header.free_offset_));
-            functor(class_object.GetClass());
+            functor(ReadClass(class_header));
         }
     }
 };
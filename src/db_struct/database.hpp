@@ -1,13 +1,20 @@
 #pragma once
 
+#include <functional>
 #include <iterator>
 #include <optional>
+#include <random>
 #include <set>
 #include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
+#include "binding.hpp"
+#include "hnsw.hpp"
+#include "ivf_pq.hpp"
+#include "nearest.hpp"
 #include "pattern.hpp"
 #include "struct.hpp"
 #include "val_node_storage.hpp"
@@ -28,7 +35,7 @@ class Database {
     mem::PageAllocator::Ptr alloc_;
     ClassStorage::Ptr class_storage_;
 
-    void InitializeSuperblock(OpenMode mode) {
+    void InitializeSuperblock(OpenMode mode, size_t page_size) {
         switch (mode) {
             case OpenMode::kRead: {
                 DEBUG("OpenMode: Read");
@@ -40,6 +47,10 @@ class Database {
                     superblock_.ReadSuperblock(file_);
                     break;
                 } catch (const error::StructureError& e) {
+                    // Data of the older format is never thrown away
+                    if (mem::Superblock::IsOtherFormat(file_)) {
+                        throw;
+                    }
                     ERROR("Can't open file in Read mode, rewriting..");
                 } catch (const error::BadArgument& e) {
                     ERROR("Can't open file in Read mode, rewriting..");
@@ -47,12 +58,37 @@ class Database {
             }
             case OpenMode::kWrite: {
                 DEBUG("OpenMode: Write");
+                // Checks page size before the file is cleared
+                file_->SetPageSize(page_size);
                 file_->Clear();
-                superblock_.InitSuperblock(file_);
+                superblock_.InitSuperblock(file_, page_size);
             } break;
         }
     }
 
+    template <ts::ClassLike C>
+    HnswIndex GetVectorIndex(const util::Ptr<C>& node_class) {
+        if (node_class->Size().has_value()) {
+            return ValNodeStorage(node_class, class_storage_, alloc_, LOGGER).GetVectorIndex();
+        }
+        return VarNodeStorage(node_class, class_storage_, alloc_, LOGGER).GetVectorIndex();
+    }
+
+    template <ts::ClassLike C>
+    IvfPqIndex GetQuantizedIndex(const util::Ptr<C>& node_class) {
+        if (node_class->Size().has_value()) {
+            return ValNodeStorage(node_class, class_storage_, alloc_, LOGGER).GetQuantizedIndex();
+        }
+        return VarNodeStorage(node_class, class_storage_, alloc_, LOGGER).GetQuantizedIndex();
+    }
+
+    void CompactIfSparse() {
+        if (alloc_->IsSparse()) {
+            DEBUG("Compaction");
+            Compact();
+        }
+    }
+
     // Probably should introduce new entity to properly match or not match cycles, but the topics
     // need more time to investigate
     struct SubPatternResult {
@@ -124,39 +160,45 @@ class Database {
         return result;
     }
 
+    using Resolver = std::function<std::optional<Node>(ts::ObjectId)>;
+    using ResolvedNodes = std::unordered_map<ts::ObjectId, std::optional<Node>>;
+
+    // Storage is kept by the resolver, so the tables are read once for all of the lookups
+    Resolver MakeResolver(const ts::Class::Ptr& node_class) {
+        if (node_class->Size().has_value()) {
+            auto storage =
+                util::MakePtr<ValNodeStorage>(node_class, class_storage_, alloc_, LOGGER);
+            return [storage](ts::ObjectId id) { return storage->FindNode(id); };
+        }
+        auto storage = util::MakePtr<VarNodeStorage>(node_class, class_storage_, alloc_, LOGGER);
+        return [storage](ts::ObjectId id) { return storage->FindNode(id); };
+    }
+
+    static std::optional<Node>& Resolve(ResolvedNodes& index, Resolver& resolver,
+                                        ts::ObjectId id) {
+        auto it = index.find(id);
+        if (it == index.end()) {
+            it = index.emplace(id, resolver(id)).first;
+        }
+        return it->second;
+    }
+
     // Very heavy operation
     // Definitly needed review and rethinking
     std::optional<PatterMatchResultImpl> PatternMatchImpl(Pattern::Ptr pattern) {
         std::optional<PatterMatchResultImpl> result = std::nullopt;
-        auto& file = alloc_->GetFile();
 
         auto structure_class =
             ts::NewClass<ts::StructClass>(GenerateName(pattern), pattern->GetRootClass());
 
         for (auto& end : pattern->GetRelations()) {
             auto pattern_result = PatternMatchImpl(end.pattern);
-            std::unordered_map<ts::ObjectId, mem::Offset> from_index;
-            std::unordered_map<ts::ObjectId, mem::Offset> to_index;
-
-            auto fill_from = [&from_index](auto node) {
-                from_index.insert({node.Id(), node.GetRealOffset()});
-            };
-            auto fill_to = [&to_index](auto node) {
-                to_index.insert({node.Id(), node.GetRealOffset()});
-            };
-
-            VisitNodes(end.relation->FromClass(), kAll, fill_from);
-            VisitNodes(end.relation->ToClass(), kAll, fill_to);
-
-            auto from_magic =
-                mem::ClassHeader(class_storage_->FindClass(end.relation->FromClass()).value())
-                    .ReadMagic(alloc_->GetFile())
-                    .magic_;
-
-            auto to_magic =
-                mem::ClassHeader(class_storage_->FindClass(end.relation->ToClass()).value())
-                    .ReadMagic(alloc_->GetFile())
-                    .magic_;
+            // Ends of relations are resolved by their ids, nodes are cached since the same node
+            // is usually the end of many relations
+            ResolvedNodes from_index;
+            ResolvedNodes to_index;
+            auto resolve_from = MakeResolver(end.relation->FromClass());
+            auto resolve_to = MakeResolver(end.relation->ToClass());
 
             //  TODO: Manage lazy deletion
             structure_class->AddField(pattern_result.has_value()
@@ -165,28 +207,34 @@ class Database {
 
             PatterMatchResultImpl inner_map;
 
-            auto merge = [&from_index, &to_index, &pattern_result, &inner_map, &end, &file,
-                          from_magic, to_magic, &structure_class](auto relation_node) {
+            auto merge = [&from_index, &to_index, &resolve_from, &resolve_to, &pattern_result,
+                          &inner_map, &end, &structure_class](auto relation_node) {
                 auto from = relation_node->template Data<ts::Relation>()->FromId();
                 auto to = relation_node->template Data<ts::Relation>()->ToId();
 
-                auto from_node =
-                    Node(from_magic, end.relation->FromClass(), file, from_index[from]);
-                auto to_node = Node(to_magic, end.relation->ToClass(), file, to_index[to]);
+                auto& from_end = Resolve(from_index, resolve_from, from);
+                auto& to_end = Resolve(to_index, resolve_to, to);
+
+                // Relations are removed lazily, so their ends could be already removed
+                if (!from_end.has_value() || !to_end.has_value()) {
+                    return;
+                }
+                Node& from_node = from_end.value();
+                Node& to_node = to_end.value();
 
                 if (end.predicate_(from_node, to_node)) {
                     if (pattern_result.has_value()) {
                         for (auto& subpattern : pattern_result.value()) {
                             if (subpattern.from == to) {
                                 // would match cycles
-                                auto new_struct = util::MakePtr<ts::Struct>(structure_class);
+                                auto new_struct = util::MakeArenaPtr<ts::Struct>(structure_class);
                                 new_struct->AddFieldValue(from_node.Data<ts::Object>());
                                 new_struct->AddFieldValue(subpattern.value);
                                 inner_map.push_back({from, {to}, new_struct});
                             }
                         }
                     } else {
-                        auto new_struct = util::MakePtr<ts::Struct>(structure_class);
+                        auto new_struct = util::MakeArenaPtr<ts::Struct>(structure_class);
                         new_struct->AddFieldValue(from_node.Data<ts::Object>());
                         new_struct->AddFieldValue(to_node.Data<ts::Object>());
                         inner_map.push_back({from, {to}, new_struct});
@@ -208,52 +256,67 @@ class Database {
 public:
     using Ptr = util::Ptr<Database>;
 
-    Database(const mem::File::Ptr& file, OpenMode mode = OpenMode::kDefault, DEFAULT_LOGGER(logger))
+    // Page size is used only when the database is created, otherwise it's read from the file
+    Database(const mem::File::Ptr& file, OpenMode mode, size_t page_size, DEFAULT_LOGGER(logger))
         : LOGGER(logger), file_(file) {
 
-        InitializeSuperblock(mode);
+        InitializeSuperblock(mode, page_size);
+        INFO("Page size: ", file_->GetPageSize());
 
         alloc_ = util::MakePtr<mem::PageAllocator>(file_, LOGGER);
         INFO("Allocator initialized");
         class_storage_ = util::MakePtr<ClassStorage>(alloc_, LOGGER);
     }
 
+    Database(const mem::File::Ptr& file, OpenMode mode = OpenMode::kDefault, DEFAULT_LOGGER(logger))
+        : Database(file, mode, mem::kDefaultPageSize, logger) {
+    }
+
     ~Database() {
         INFO("Closing database");
     };
 
     template <ts::ClassLike C>
-    void AddClass(const util::Ptr<C>& new_class) {
-        class_storage_->AddClass(new_class);
+    void AddClass(const util::Ptr<C>& new_class,
+                  mem::NodeLayout layout = mem::NodeLayout::kDefault) {
+        class_storage_->AddClass(new_class, layout);
     }
 
     template <ts::ClassLike C>
     void RemoveClass(const util::Ptr<C>& node_class) {
-        NodeStorage(node_class, class_storage_, alloc_, LOGGER).Drop();
+        if (node_class->Size().has_value()) {
+            ValNodeStorage(node_class, class_storage_, alloc_, LOGGER).Drop();
+        } else {
+            VarNodeStorage(node_class, class_storage_, alloc_, LOGGER).Drop();
+        }
         class_storage_->RemoveClass(node_class);
+        CompactIfSparse();
+    }
+
+    // Relocates live pages to the beginning of the file and shrinks it, invalidates all iterators
+    void Compact() {
+        auto relocations = alloc_->Compact();
+        if (!relocations.empty()) {
+            class_storage_->ReloadCache();
+            class_storage_->VisitClasses([this](ts::Class::Ptr node_class) {
+                if (node_class->Size().has_value()) {
+                    ValNodeStorage(node_class, class_storage_, alloc_, LOGGER).RebuildIndices();
+                } else {
+                    VarNodeStorage(node_class, class_storage_, alloc_, LOGGER).RebuildIndices();
+                }
+            });
+        }
     }
 
     template <ts::ClassLike C>
     bool Contains(const util::Ptr<C>& node_class) {
-        bool found = 0;
-        std::string serialized = node_class->Serialize();
-        class_storage_->VisitClasses([&found, &serialized](ts::Class::Ptr stored_class) {
-            if (found) {
-                return;
-            }
-            if (stored_class->Serialize() == serialized) {
-                found = true;
-            }
-        });
-        return found;
+        return class_storage_->FindClass(node_class, DataMode::kFile).has_value();
     }
 
     void PrintClasses(std::ostream& os = std::cout) {
-        auto& alloc = alloc_;
-        class_storage_->VisitClasses([alloc, &os](mem::ClassHeader class_header) -> void {
-            ts::ClassObject class_object;
-            class_object.Read(alloc->GetFile(),
-                              mem::GetOffset(class_header.index_, class_header.free_offset_));
+        auto& class_storage = class_storage_;
+        class_storage_->VisitClasses([&class_storage, &os](mem::ClassHeader class_header) -> void {
+            auto class_object = ts::ClassObject(class_storage->ReadClass(class_header));
             os << " [ " << class_header.index_ << " ] " << class_object.ToString() << std::endl;
         });
     }
@@ -267,6 +330,216 @@ public:
         }
     }
 
+    // Node is encoded straight from the struct bound by DDB_STRUCT, its class should be added as
+    // ts::ClassOf<T>()
+    template <ts::Bound T>
+    void Insert(T value) {
+        AddNode(util::MakePtr<ts::BoundObject<T>>(std::move(value)));
+    }
+
+    // Nodes are decoded from the copy of the page into the same struct, no objects are built
+    template <ts::Bound T, typename Functor>
+    requires std::is_invocable_v<Functor, const T&>
+    void Visit(Functor functor) {
+        T value;
+        VisitNodes(ts::ClassOf<T>(), kAll, [&value, &functor](auto it) {
+            auto data = it.View().Data().data();
+            ts::Decode(value, data);
+            functor(std::as_const(value));
+        });
+    }
+
+    // Exact search of the k vectors of the field closest to the query, vectors are read in place
+    // from the copies of the pages. Nodes with unset bits of the filter are skipped, the result is
+    // sorted from the closest
+    template <ts::ClassLike C>
+    std::vector<Neighbor> NearestNeighbors(const util::Ptr<C>& node_class, std::string_view field,
+                                           std::span<const float> query, size_t k,
+                                           Metric metric = Metric::kL2,
+                                           const IdBitmap* filter = nullptr) {
+        auto vector_field = VectorField(node_class, field);
+        auto dimension = vector_field.GetClass().Dimension();
+        if (query.size() != dimension) {
+            throw error::BadArgument("Query dimension doesn't match the field");
+        }
+        auto distance = Distance(metric, query);
+
+        // Heap and buffer are reused by the queries of the thread
+        thread_local TopK top;
+        thread_local util::AlignedVector<float> buffer;
+        top.Reset(k);
+        ts::VisitElement(vector_field.GetClass().Element(), [&](auto type) {
+            using E = typename decltype(type)::type;
+            VisitNodes(node_class, kAll, [&](auto it) {
+                auto view = it.View();
+                auto id = view.Id();
+                if (filter != nullptr && (id >= filter->size() || !(*filter)[id])) {
+                    return;
+                }
+                top.Push(id, distance(ToFloats<E>(vector_field.Locate(view.Data()), dimension,
+                                                  buffer)));
+            });
+        });
+        return top.Take();
+    }
+
+    // Approximate index over the vector field is built from the nodes of the class and then kept
+    // up to date by the insertions and removals of nodes, it lives in the pages of the class
+    template <ts::ClassLike C>
+    void CreateVectorIndex(const util::Ptr<C>& node_class, std::string_view field,
+                           const HnswParams& params = {}, Metric metric = Metric::kL2) {
+        auto vector_field = VectorField(node_class, field);
+        auto index = GetVectorIndex(node_class);
+        index.Create(field, vector_field.GetClass().Dimension(), params, metric);
+        VisitNodes(node_class, kAll, [&](auto it) {
+            auto view = it.View();
+            index.Insert(node_class, view.Id(), view.Data());
+        });
+    }
+
+    template <ts::ClassLike C>
+    void DropVectorIndex(const util::Ptr<C>& node_class) {
+        GetVectorIndex(node_class).Drop();
+        CompactIfSparse();
+    }
+
+    // Width of the search that is used when the query doesn't give its own
+    template <ts::ClassLike C>
+    void SetVectorIndexEfSearch(const util::Ptr<C>& node_class, size_t ef_search) {
+        auto index = GetVectorIndex(node_class);
+        if (!index.IsBuilt()) {
+            throw error::BadArgument("No vector index for the class");
+        }
+        index.SetEfSearch(ef_search);
+    }
+
+    // Search of the k closest vectors in the index of the class, the result is sorted from the
+    // closest. Recall grows with ef_search at the cost of the latency
+    template <ts::ClassLike C>
+    std::vector<Neighbor> ApproximateNeighbors(const util::Ptr<C>& node_class,
+                                               std::span<const float> query, size_t k,
+                                               std::optional<size_t> ef_search = std::nullopt) {
+        auto index = GetVectorIndex(node_class);
+        if (!index.IsBuilt()) {
+            throw error::BadArgument("No vector index for the class");
+        }
+        return index.Search(query, k, ef_search);
+    }
+
+    // Compressed index over the vector field: centroids and codebooks are trained on the uniform
+    // sample of the nodes, then every node is encoded. It's kept up to date like the graph index,
+    // but the nodes added after the training don't change the model
+    template <ts::ClassLike C>
+    void CreateQuantizedIndex(const util::Ptr<C>& node_class, std::string_view field,
+                              const IvfPqParams& params = {}, Metric metric = Metric::kL2) {
+        auto vector_field = VectorField(node_class, field);
+        auto dimension = vector_field.GetClass().Dimension();
+        std::vector<float> sample;
+        {
+            // Reservoir keeps the uniform sample in one pass over the nodes
+            std::mt19937_64 generator(params.sample_);
+            util::AlignedVector<float> buffer;
+            size_t seen = 0;
+            ts::VisitElement(vector_field.GetClass().Element(), [&](auto type) {
+                using E = typename decltype(type)::type;
+                VisitNodes(node_class, kAll, [&](auto it) {
+                    auto slot = seen++;
+                    if (slot >= params.sample_) {
+                        slot = std::uniform_int_distribution<size_t>(0, slot)(generator);
+                        if (slot >= params.sample_) {
+                            return;
+                        }
+                    } else {
+                        sample.resize(sample.size() + dimension);
+                    }
+                    auto values = ToFloats<E>(vector_field.Locate(it.View().Data()), dimension,
+                                              buffer);
+                    std::copy_n(values, dimension, sample.begin() + slot * dimension);
+                });
+            });
+        }
+        auto index = GetQuantizedIndex(node_class);
+        index.Create(field, dimension, params, metric, sample);
+        VisitNodes(node_class, kAll, [&](auto it) {
+            auto view = it.View();
+            index.Insert(node_class, view.Id(), view.Data());
+        });
+    }
+
+    template <ts::ClassLike C>
+    void DropQuantizedIndex(const util::Ptr<C>& node_class) {
+        GetQuantizedIndex(node_class).Drop();
+        CompactIfSparse();
+    }
+
+    // Search of the k closest vectors by their codes, the distances are approximate. Recall grows
+    // with the count of probed lists at the cost of the latency
+    template <ts::ClassLike C>
+    std::vector<Neighbor> QuantizedNeighbors(const util::Ptr<C>& node_class,
+                                             std::span<const float> query, size_t k,
+                                             std::optional<size_t> probes = std::nullopt) {
+        auto index = GetQuantizedIndex(node_class);
+        if (!index.IsBuilt()) {
+            throw error::BadArgument("No quantized index for the class");
+        }
+        return index.Search(query, k, probes);
+    }
+
+    // Statistics are kept in the class header, so nodes aren't visited
+    template <ts::ClassLike C>
+    ClassStats Stats(const util::Ptr<C>& node_class) {
+        if (node_class->Size().has_value()) {
+            return ValNodeStorage(node_class, class_storage_, alloc_, LOGGER).Stats();
+        }
+        return VarNodeStorage(node_class, class_storage_, alloc_, LOGGER).Stats();
+    }
+
+    // Builds histograms and distinct counts of primitive and string fields and degrees of relation
+    // ends in one pass over the nodes, the result replaces the previous one in the file
+    template <ts::ClassLike C>
+    ClassAnalysis Analyze(const util::Ptr<C>& node_class) {
+        Analyzer analyzer;
+        {
+            // Objects are dropped right after they are counted
+            util::Arena arena;
+            VisitNodes(node_class, kAll,
+                       [&analyzer](auto node) { analyzer.Add(node->template Data<ts::Object>()); });
+        }
+        auto analysis = analyzer.Build();
+        if (node_class->Size().has_value()) {
+            ValNodeStorage(node_class, class_storage_, alloc_, LOGGER)
+                .GetAnalysisStorage()
+                .Write(analysis);
+        } else {
+            VarNodeStorage(node_class, class_storage_, alloc_, LOGGER)
+                .GetAnalysisStorage()
+                .Write(analysis);
+        }
+        return analysis;
+    }
+
+    // Returns the result of the last analysis of the class
+    template <ts::ClassLike C>
+    std::optional<ClassAnalysis> GetAnalysis(const util::Ptr<C>& node_class) {
+        if (node_class->Size().has_value()) {
+            return ValNodeStorage(node_class, class_storage_, alloc_, LOGGER)
+                .GetAnalysisStorage()
+                .Read();
+        }
+        return VarNodeStorage(node_class, class_storage_, alloc_, LOGGER)
+            .GetAnalysisStorage()
+            .Read();
+    }
+
+    // Returns the node with the id or nothing if it was removed
+    template <ts::ClassLike C>
+    std::optional<Node> FindNode(const util::Ptr<C>& node_class, ts::ObjectId id) {
+        if (node_class->Size().has_value()) {
+            return ValNodeStorage(node_class, class_storage_, alloc_, LOGGER).FindNode(id);
+        }
+        return VarNodeStorage(node_class, class_storage_, alloc_, LOGGER).FindNode(id);
+    }
+
     template <ts::ClassLike C, typename Predicate>
     void RemoveNodesIf(const util::Ptr<C>& node_class, Predicate predicate) {
         if (node_class->Size().has_value()) {
@@ -283,6 +556,7 @@ public:
                 ERROR("Bad predicate");
             }
         }
+        CompactIfSparse();
     }
 
     // TODO: I'm thinking about implementing some sort of Java StreamAPI-like API in future it
@@ -294,7 +568,8 @@ public:
     template <ts::ClassLike C, typename Predicate, typename Functor>
     void VisitNodes(const util::Ptr<C>& node_class, Predicate predicate, Functor functor) {
         if (node_class->Size().has_value()) {
-            if constexpr (std::is_invocable_r_v<bool, Predicate, ValNodeIterator>) {
+            if constexpr (std::is_invocable_r_v<bool, Predicate, ValNodeIterator> &&
+                          std::is_invocable_v<Functor, ValNodeIterator>) {
                 ValNodeStorage(node_class, class_storage_, alloc_, LOGGER)
                     .VisitNodes(predicate, functor);
             } else {
@@ -302,7 +577,8 @@ public:
             }
 
         } else {
-            if constexpr (std::is_invocable_r_v<bool, Predicate, VarNodeIterator>) {
+            if constexpr (std::is_invocable_r_v<bool, Predicate, VarNodeIterator> &&
+                          std::is_invocable_v<Functor, VarNodeIterator>) {
                 VarNodeStorage(node_class, class_storage_, alloc_, LOGGER)
                     .VisitNodes(predicate, functor);
             } else {
@@ -329,6 +605,8 @@ public:
 
     // Very heavy operation
     // Definitly needed review and rethinking
+    // Run it inside util::Arena to release all of the matched objects at once, the results
+    // shouldn't outlive the arena then
     template <typename Container>
     void PatternMatch(Pattern::Ptr pattern, std::back_insert_iterator<Container> back_inserter) {
         auto result_impl = PatternMatchImpl(pattern);
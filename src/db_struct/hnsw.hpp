@@ -0,0 +1,536 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <optional>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "nearest.hpp"
+#include "paged_array.hpp"
+
+namespace db {
+
+// M is the number of links of a node on the upper layers, the bottom layer keeps twice as many.
+// Bigger ef gives better recall for slower insertion and search
+struct HnswParams {
+    size_t m_ = 16;
+    size_t ef_construction_ = 200;
+    size_t ef_search_ = 64;
+};
+
+// Pages of the graph read by the index object, every page is read once instead of a read per
+// distance and per list of links. Writes go through to the file, pointers are valid until the next
+// Get since the pages are dropped all at once when there are too many of them
+class GraphPages {
+    static constexpr size_t kMaxBytes = 64 << 20;
+
+    mem::File::Ptr file_;
+    std::unordered_map<mem::PageIndex, util::AlignedVector<char>> pages_;
+    size_t loads_ = 0;
+
+public:
+    explicit GraphPages(mem::File::Ptr file) : file_(std::move(file)) {
+    }
+
+    [[nodiscard]] const char* Get(mem::Offset offset) {
+        auto index = mem::GetIndex(offset, file_);
+        auto it = pages_.find(index);
+        if (it == pages_.end()) {
+            if ((pages_.size() + 1) * file_->GetPageSize() > kMaxBytes) {
+                pages_.clear();
+            }
+            it = pages_.emplace(index, util::AlignedVector<char>(file_->GetPageSize())).first;
+            file_->ReadBuffer(it->second.data(), mem::GetPageAddress(index, file_),
+                              it->second.size());
+            ++loads_;
+        }
+        return it->second.data() + (offset - mem::GetPageAddress(index, file_));
+    }
+
+    template <typename T>
+    [[nodiscard]] T Read(mem::Offset offset) {
+        T value;
+        std::memcpy(&value, Get(offset), sizeof(T));
+        return value;
+    }
+
+    void Write(const char* data, mem::Offset offset, size_t size) {
+        file_->WriteBuffer(data, offset, size);
+        auto index = mem::GetIndex(offset, file_);
+        if (auto it = pages_.find(index); it != pages_.end()) {
+            std::memcpy(it->second.data() + (offset - mem::GetPageAddress(index, file_)), data,
+                        size);
+        }
+    }
+
+    template <typename T>
+    void Write(const T& value, mem::Offset offset) {
+        Write(reinterpret_cast<const char*>(&value), offset, sizeof(T));
+    }
+
+    // Pages read from the file since the object was created
+    [[nodiscard]] size_t Loads() const {
+        return loads_;
+    }
+
+    void Clear() {
+        pages_.clear();
+    }
+};
+
+// Hierarchical navigable small world graph over a vector field of the class. Vectors are copied
+// into the nodes of the graph, so the search doesn't read the records. Removed nodes are left as
+// tombstones: they still route the search but aren't returned
+class HnswIndex {
+    static constexpr size_t kMaxFieldLength = 64;
+    static constexpr uint64_t kNoEntry = UINT64_MAX;
+    static constexpr uint32_t kMaxLevel = 32;
+
+    // Lives in the only page of the index list, the tables are chained to their sentinels here
+    struct Header {
+        uint32_t m_;
+        uint32_t ef_construction_;
+        uint32_t ef_search_;
+        uint32_t dimension_;
+        Metric metric_;
+        uint32_t max_level_;
+        uint64_t entry_;
+        uint64_t tombstones_;
+        uint64_t rng_;
+        char field_[kMaxFieldLength];
+        // Nodes with their bottom layer links and vectors
+        mem::Page nodes_sentinel_;
+        size_t nodes_pages_count_;
+        size_t nodes_size_;
+        // Links of the upper layers, the layers of a node are consecutive
+        mem::Page links_sentinel_;
+        size_t links_pages_count_;
+        size_t links_size_;
+        // Maps ids to the nodes of the graph shifted by one, zero is no node
+        mem::Page ids_sentinel_;
+        size_t ids_pages_count_;
+        size_t ids_size_;
+    };
+
+    // Followed by 2M links of the bottom layer and the vector
+    struct NodeHead {
+        ts::ObjectId id_;
+        uint32_t level_;
+        uint32_t deleted_;
+        uint64_t upper_;
+        uint32_t count_;
+        uint32_t padding_;
+    };
+
+    struct Candidate {
+        float distance_;
+        uint64_t index_;
+        ts::ObjectId id_;
+        bool deleted_;
+    };
+
+    DECLARE_LOGGER;
+    mem::PageAllocator::Ptr alloc_;
+    mem::PageList page_list_;
+    Header header_;
+    mem::Offset header_offset_ = 0;
+    std::optional<mem::PagedBlocks> nodes_;
+    std::optional<mem::PagedBlocks> links_;
+    std::optional<mem::PagedArray<uint64_t>> ids_;
+    GraphPages pages_;
+
+    [[nodiscard]] mem::Offset FieldOffset(const auto& field) const {
+        return header_offset_ + static_cast<mem::Offset>(reinterpret_cast<const char*>(&field) -
+                                                         reinterpret_cast<const char*>(&header_));
+    }
+
+    template <typename T>
+    void WriteField(const T& field) {
+        alloc_->GetFile()->Write<T>(field, FieldOffset(field));
+    }
+
+    [[nodiscard]] size_t MaxLinks(uint32_t level) const {
+        return level == 0 ? 2 * header_.m_ : header_.m_;
+    }
+
+    [[nodiscard]] size_t VectorOffset() const {
+        return sizeof(NodeHead) + 2 * header_.m_ * sizeof(uint32_t);
+    }
+
+    [[nodiscard]] size_t NodeBlockSize() const {
+        return VectorOffset() + header_.dimension_ * sizeof(float);
+    }
+
+    [[nodiscard]] size_t LinksBlockSize() const {
+        return (1 + header_.m_) * sizeof(uint32_t);
+    }
+
+    void Open() {
+        auto& file = alloc_->GetFile();
+        header_offset_ = mem::GetOffset(page_list_.Front(), sizeof(mem::Page), file);
+        header_ = file->Read<Header>(header_offset_);
+        nodes_.emplace("Hnsw_Nodes", alloc_, FieldOffset(header_.nodes_sentinel_), NodeBlockSize(),
+                       LOGGER);
+        links_.emplace("Hnsw_Links", alloc_, FieldOffset(header_.links_sentinel_),
+                       LinksBlockSize(), LOGGER);
+        ids_.emplace("Hnsw_Ids", alloc_, FieldOffset(header_.ids_sentinel_), LOGGER);
+    }
+
+    // Exponentially decaying level with the factor 1 / ln(M), the state is kept in the header so
+    // the graph is the same after the restart
+    [[nodiscard]] uint32_t RandomLevel() {
+        auto state = (header_.rng_ += 0x9e3779b97f4a7c15);
+        state = (state ^ (state >> 30)) * 0xbf58476d1ce4e5b9;
+        state = (state ^ (state >> 27)) * 0x94d049bb133111eb;
+        state ^= state >> 31;
+        WriteField(header_.rng_);
+        auto uniform = static_cast<double>((state >> 11) + 1) * 0x1.0p-53;
+        auto level = -std::log(uniform) / std::log(static_cast<double>(header_.m_));
+        return std::min(static_cast<uint32_t>(level), kMaxLevel);
+    }
+
+    // Blocks are aligned as floats in the page, so the vector is compared in place
+    [[nodiscard]] Candidate Evaluate(const Distance& distance, uint64_t index) {
+        auto block = pages_.Get(nodes_->GetBlockOffset(index));
+        NodeHead head;
+        std::memcpy(&head, block, sizeof(NodeHead));
+        return Candidate{distance(reinterpret_cast<const float*>(block + VectorOffset())), index,
+                         head.id_, head.deleted_ != 0};
+    }
+
+    [[nodiscard]] util::AlignedVector<float> ReadVector(uint64_t index) {
+        auto data = reinterpret_cast<const float*>(
+            pages_.Get(nodes_->GetBlockOffset(index) + VectorOffset()));
+        return util::AlignedVector<float>(data, data + header_.dimension_);
+    }
+
+    // Count of the links is followed by the links themselves
+    [[nodiscard]] mem::Offset LinksOffset(uint64_t index, uint32_t level) {
+        auto offset = nodes_->GetBlockOffset(index);
+        if (level == 0) {
+            return offset + offsetof(NodeHead, count_);
+        }
+        auto upper = pages_.Read<uint64_t>(offset + offsetof(NodeHead, upper_));
+        return links_->GetBlockOffset(upper + level - 1);
+    }
+
+    [[nodiscard]] static mem::Offset LinksGap(uint32_t level) {
+        return level == 0 ? sizeof(NodeHead) - offsetof(NodeHead, count_) : sizeof(uint32_t);
+    }
+
+    [[nodiscard]] std::vector<uint32_t> ReadLinks(uint64_t index, uint32_t level) {
+        auto offset = LinksOffset(index, level);
+        std::vector<uint32_t> links(pages_.Read<uint32_t>(offset));
+        if (!links.empty()) {
+            std::memcpy(links.data(), pages_.Get(offset + LinksGap(level)),
+                        links.size() * sizeof(uint32_t));
+        }
+        return links;
+    }
+
+    void WriteLinks(uint64_t index, uint32_t level, const std::vector<uint32_t>& links) {
+        auto offset = LinksOffset(index, level);
+        pages_.Write<uint32_t>(static_cast<uint32_t>(links.size()), offset);
+        if (!links.empty()) {
+            pages_.Write(reinterpret_cast<const char*>(links.data()), offset + LinksGap(level),
+                         links.size() * sizeof(uint32_t));
+        }
+    }
+
+    // Closest ef nodes of the layer reachable from the entries, from the closest
+    [[nodiscard]] std::vector<Candidate> SearchLayer(const Distance& distance,
+                                                     const std::vector<Candidate>& entries,
+                                                     size_t ef, uint32_t level) {
+        auto closer = [](const Candidate& lhs, const Candidate& rhs) {
+            return lhs.distance_ > rhs.distance_;
+        };
+        auto farther = [](const Candidate& lhs, const Candidate& rhs) {
+            return lhs.distance_ < rhs.distance_;
+        };
+        std::unordered_set<uint64_t> visited;
+        std::priority_queue<Candidate, std::vector<Candidate>, decltype(closer)> candidates(closer);
+        std::priority_queue<Candidate, std::vector<Candidate>, decltype(farther)> found(farther);
+        for (auto& entry : entries) {
+            visited.insert(entry.index_);
+            candidates.push(entry);
+            found.push(entry);
+        }
+        while (found.size() > ef) {
+            found.pop();
+        }
+
+        while (!candidates.empty()) {
+            auto current = candidates.top();
+            if (found.size() >= ef && current.distance_ > found.top().distance_) {
+                break;
+            }
+            candidates.pop();
+            for (auto link : ReadLinks(current.index_, level)) {
+                if (!visited.insert(link).second) {
+                    continue;
+                }
+                auto candidate = Evaluate(distance, link);
+                if (found.size() < ef || candidate.distance_ < found.top().distance_) {
+                    candidates.push(candidate);
+                    found.push(candidate);
+                    if (found.size() > ef) {
+                        found.pop();
+                    }
+                }
+            }
+        }
+
+        std::vector<Candidate> result(found.size());
+        for (auto it = result.rbegin(); it != result.rend(); ++it) {
+            *it = found.top();
+            found.pop();
+        }
+        return result;
+    }
+
+    // Candidates are taken from the closest, the one that is closer to a kept neighbour than to
+    // the node is skipped, so the links lead to every cluster around the node, not only to the
+    // closest one
+    [[nodiscard]] std::vector<uint32_t> SelectNeighbours(const std::vector<Candidate>& candidates,
+                                                         size_t count) {
+        std::vector<uint32_t> selected;
+        for (auto& candidate : candidates) {
+            if (selected.size() == count) {
+                break;
+            }
+            auto vector = ReadVector(candidate.index_);
+            auto distance = Distance(header_.metric_,
+                                     std::span<const float>(vector.data(), vector.size()));
+            if (std::ranges::all_of(selected, [&](uint32_t kept) {
+                    return Evaluate(distance, kept).distance_ >= candidate.distance_;
+                })) {
+                selected.push_back(static_cast<uint32_t>(candidate.index_));
+            }
+        }
+        return selected;
+    }
+
+    // Link to the new node is added to the neighbour, the links are selected again when there are
+    // too many of them
+    void Connect(uint64_t index, uint64_t link, uint32_t level) {
+        auto links = ReadLinks(index, level);
+        links.push_back(static_cast<uint32_t>(link));
+        if (links.size() > MaxLinks(level)) {
+            auto vector = ReadVector(index);
+            auto distance = Distance(header_.metric_,
+                                     std::span<const float>(vector.data(), vector.size()));
+            std::vector<Candidate> candidates;
+            for (auto neighbour : links) {
+                candidates.push_back(Evaluate(distance, neighbour));
+            }
+            std::sort(candidates.begin(), candidates.end(),
+                      [](const Candidate& lhs, const Candidate& rhs) {
+                          return lhs.distance_ < rhs.distance_;
+                      });
+            links = SelectNeighbours(candidates, MaxLinks(level));
+        }
+        WriteLinks(index, level, links);
+    }
+
+    // Descends from the entry of the graph to the layer, one closest node per layer
+    [[nodiscard]] std::vector<Candidate> Descend(const Distance& distance, uint32_t level) {
+        auto entries = std::vector<Candidate>{Evaluate(distance, header_.entry_)};
+        for (auto current = header_.max_level_; current > level; --current) {
+            entries = SearchLayer(distance, entries, 1, current);
+        }
+        return entries;
+    }
+
+public:
+    HnswIndex(mem::PageAllocator::Ptr& alloc, mem::Offset sentinel_offset,
+              DEFAULT_LOGGER(logger))
+        : LOGGER(logger),
+          alloc_(alloc),
+          page_list_("Vector_Index", alloc_->GetFile(), sentinel_offset, LOGGER),
+          header_{},
+          pages_(alloc_->GetFile()) {
+        if (!page_list_.IsEmpty()) {
+            Open();
+        }
+    }
+
+    [[nodiscard]] bool IsBuilt() const {
+        return nodes_.has_value();
+    }
+
+    [[nodiscard]] std::string_view Field() const {
+        return std::string_view(header_.field_);
+    }
+
+    [[nodiscard]] size_t Size() const {
+        return nodes_.has_value() ? nodes_->Size() - header_.tombstones_ : 0;
+    }
+
+    [[nodiscard]] size_t Tombstones() const {
+        return header_.tombstones_;
+    }
+
+    [[nodiscard]] size_t PagesRead() const {
+        return pages_.Loads();
+    }
+
+    void Create(std::string_view field, size_t dimension, const HnswParams& params,
+                Metric metric) {
+        if (IsBuilt()) {
+            throw error::BadArgument("Vector index already exists");
+        }
+        if (field.size() >= kMaxFieldLength) {
+            throw error::NotImplemented("Too long field path");
+        }
+        if (params.m_ < 2 || params.ef_construction_ == 0 || params.ef_search_ == 0) {
+            throw error::BadArgument("Invalid index parameters");
+        }
+        header_ = Header{};
+        header_.m_ = static_cast<uint32_t>(params.m_);
+        header_.ef_construction_ = static_cast<uint32_t>(params.ef_construction_);
+        header_.ef_search_ = static_cast<uint32_t>(params.ef_search_);
+        header_.dimension_ = static_cast<uint32_t>(dimension);
+        header_.metric_ = metric;
+        header_.entry_ = kNoEntry;
+        std::memcpy(header_.field_, field.data(), field.size());
+        for (auto sentinel : {&header_.nodes_sentinel_, &header_.links_sentinel_,
+                              &header_.ids_sentinel_}) {
+            *sentinel = mem::Page(mem::kSentinelIndex);
+            sentinel->type_ = mem::PageType::kSentinel;
+        }
+        if (NodeBlockSize() > alloc_->GetPageSize() - sizeof(mem::Page)) {
+            throw error::NotImplemented("Too big vectors for the index");
+        }
+
+        auto& file = alloc_->GetFile();
+        page_list_.PushBack(alloc_->AllocatePage());
+        auto page = mem::ReadPage(mem::Page(page_list_.Back()), file);
+        page.type_ = mem::PageType::kVectorIndex;
+        mem::WritePage(page, file);
+        file->Write<Header>(header_, mem::GetOffset(page.index_, sizeof(mem::Page), file));
+        Open();
+        INFO("Vector index created on ", field);
+    }
+
+    void SetEfSearch(size_t ef_search) {
+        if (ef_search == 0) {
+            throw error::BadArgument("Invalid index parameters");
+        }
+        header_.ef_search_ = static_cast<uint32_t>(ef_search);
+        WriteField(header_.ef_search_);
+    }
+
+    void Insert(ts::ObjectId id, const float* vector) {
+        auto level = RandomLevel();
+        auto index = nodes_->PushBack();
+        auto offset = nodes_->GetBlockOffset(index);
+        pages_.Write<NodeHead>(NodeHead{id, level, 0, links_->Size(), 0, 0}, offset);
+        pages_.Write(reinterpret_cast<const char*>(vector), offset + VectorOffset(),
+                     header_.dimension_ * sizeof(float));
+        for (uint32_t current = 1; current <= level; ++current) {
+            pages_.Write<uint32_t>(0, links_->GetBlockOffset(links_->PushBack()));
+        }
+        ids_->Extend(id + 1, 0);
+        ids_->Set(id, index + 1);
+
+        if (header_.entry_ == kNoEntry) {
+            header_.entry_ = index;
+            header_.max_level_ = level;
+            WriteField(header_.entry_);
+            WriteField(header_.max_level_);
+            return;
+        }
+
+        auto distance = Distance(header_.metric_,
+                                 std::span<const float>(vector, header_.dimension_));
+        auto entries = Descend(distance, level);
+        for (auto current = std::min(level, header_.max_level_) + 1; current-- > 0;) {
+            entries = SearchLayer(distance, entries, header_.ef_construction_, current);
+            auto links = SelectNeighbours(entries, header_.m_);
+            WriteLinks(index, current, links);
+            for (auto link : links) {
+                Connect(link, index, current);
+            }
+        }
+        if (level > header_.max_level_) {
+            header_.entry_ = index;
+            header_.max_level_ = level;
+            WriteField(header_.entry_);
+            WriteField(header_.max_level_);
+        }
+    }
+
+    // Vector is taken from the serialized node
+    void Insert(const ts::Class::Ptr& node_class, ts::ObjectId id, std::string_view record) {
+        auto field = VectorField(node_class, Field());
+        thread_local util::AlignedVector<float> buffer;
+        ts::VisitElement(field.GetClass().Element(), [&](auto type) {
+            using E = typename decltype(type)::type;
+            Insert(id, ToFloats<E>(field.Locate(record), header_.dimension_, buffer));
+        });
+    }
+
+    void Remove(ts::ObjectId id) {
+        if (id >= ids_->Size()) {
+            return;
+        }
+        auto node = ids_->Get(id);
+        if (node == 0) {
+            return;
+        }
+        pages_.Write<uint32_t>(1, nodes_->GetBlockOffset(node - 1) + offsetof(NodeHead, deleted_));
+        ids_->Set(id, 0);
+        ++header_.tombstones_;
+        WriteField(header_.tombstones_);
+    }
+
+    // The search is widened while tombstones leave less than k live nodes among the candidates
+    [[nodiscard]] std::vector<Neighbor> Search(std::span<const float> query, size_t k,
+                                               std::optional<size_t> ef_search = std::nullopt) {
+        if (query.size() != header_.dimension_) {
+            throw error::BadArgument("Query dimension doesn't match the index");
+        }
+        if (header_.entry_ == kNoEntry || k == 0) {
+            return {};
+        }
+        auto distance = Distance(header_.metric_, query);
+        auto entries = Descend(distance, 0);
+        auto ef = std::max(ef_search.value_or(header_.ef_search_), k);
+        std::vector<Neighbor> result;
+        while (true) {
+            auto found = SearchLayer(distance, entries, ef, 0);
+            result.clear();
+            for (auto& candidate : found) {
+                if (!candidate.deleted_ && result.size() < k) {
+                    result.push_back(Neighbor{candidate.id_, candidate.distance_});
+                }
+            }
+            if (result.size() == k || found.size() < ef) {
+                return result;
+            }
+            ef *= 2;
+        }
+    }
+
+    void Drop() {
+        if (!IsBuilt()) {
+            return;
+        }
+        nodes_->Drop();
+        links_->Drop();
+        ids_->Drop();
+        nodes_.reset();
+        links_.reset();
+        ids_.reset();
+        pages_.Clear();
+        auto index = page_list_.Back();
+        page_list_.PopBack();
+        alloc_->FreePage(index);
+        header_ = Header{};
+    }
+};
+
+}  // namespace db
@@ -0,0 +1,551 @@
+#pragma once
+
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "nearest.hpp"
+#include "paged_array.hpp"
+
+namespace db {
+
+// Lists are the coarse clusters of the vectors. Every vector is split into subspaces and the part
+// of its residual in the subspace is replaced by the byte of the closest of up to 256 centroids.
+// Probes are the lists visited by the search, the sample is the count of vectors for the training
+struct IvfPqParams {
+    size_t lists_ = 64;
+    size_t subspaces_ = 8;
+    size_t probes_ = 8;
+    size_t sample_ = 16384;
+    size_t iterations_ = 16;
+};
+
+[[nodiscard]] inline size_t ClosestCentroid(const float* centroids, size_t count, size_t dimension,
+                                            const float* point) {
+    size_t closest = 0;
+    auto closest_distance = std::numeric_limits<float>::infinity();
+    for (size_t i = 0; i < count; ++i) {
+        auto distance = util::simd::L2(point, centroids + i * dimension, dimension);
+        if (distance < closest_distance) {
+            closest = i;
+            closest_distance = distance;
+        }
+    }
+    return closest;
+}
+
+// Lloyd iterations started from distinct random points, emptied clusters take random points
+[[nodiscard]] inline std::vector<float> TrainKMeans(const std::vector<float>& points,
+                                                    size_t dimension, size_t k, size_t iterations,
+                                                    std::mt19937_64& generator) {
+    auto count = points.size() / dimension;
+    if (k == 0 || k > count) {
+        throw error::BadArgument("Not enough points for the clusters");
+    }
+    std::vector<size_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), generator);
+    std::vector<float> centroids(k * dimension);
+    for (size_t i = 0; i < k; ++i) {
+        std::copy_n(points.begin() + order[i] * dimension, dimension,
+                    centroids.begin() + i * dimension);
+    }
+
+    std::vector<float> sums(k * dimension);
+    std::vector<size_t> sizes(k);
+    std::uniform_int_distribution<size_t> random_point(0, count - 1);
+    for (size_t iteration = 0; iteration < iterations; ++iteration) {
+        std::fill(sums.begin(), sums.end(), 0.f);
+        std::fill(sizes.begin(), sizes.end(), 0);
+        for (size_t i = 0; i < count; ++i) {
+            auto point = points.data() + i * dimension;
+            auto cluster = ClosestCentroid(centroids.data(), k, dimension, point);
+            ++sizes[cluster];
+            for (size_t j = 0; j < dimension; ++j) {
+                sums[cluster * dimension + j] += point[j];
+            }
+        }
+        for (size_t cluster = 0; cluster < k; ++cluster) {
+            auto centroid = centroids.begin() + cluster * dimension;
+            if (sizes[cluster] == 0) {
+                std::copy_n(points.begin() + random_point(generator) * dimension, dimension,
+                            centroid);
+                continue;
+            }
+            for (size_t j = 0; j < dimension; ++j) {
+                centroid[j] = sums[cluster * dimension + j] / static_cast<float>(sizes[cluster]);
+            }
+        }
+    }
+    return centroids;
+}
+
+// Inverted file of product quantized vectors of a field of the class, only the lists visited by
+// the search are read and an entry takes the id and a byte per subspace. Distances are computed
+// asymmetrically: the query is kept as is and the table of its distances to the centroids of the
+// subspaces is summed by the codes. Vectors are normalized for the cosine, so half of their
+// squared distance is one minus the cosine
+class IvfPqIndex {
+    static constexpr size_t kMaxFieldLength = 64;
+    static constexpr size_t kMaxCodes = 256;
+    static constexpr ts::ObjectId kRemoved = UINT64_MAX;
+    // List is rewritten once this share of its entries are tombstones
+    static constexpr size_t kCompactShare = 4;
+
+    // Lives in the only page of the index list, the tables are chained to their sentinels here
+    struct Header {
+        uint32_t dimension_;
+        uint32_t lists_;
+        uint32_t subspaces_;
+        uint32_t codes_;
+        uint32_t probes_;
+        Metric metric_;
+        uint64_t tombstones_;
+        char field_[kMaxFieldLength];
+        // Coarse centroids followed by the codebooks of the subspaces
+        mem::Page model_sentinel_;
+        size_t model_pages_count_;
+        // Sentinels of the tables of the lists
+        mem::Page directory_sentinel_;
+        size_t directory_pages_count_;
+        size_t directory_size_;
+        // Maps ids to their lists shifted by one, zero is no vector
+        mem::Page ids_sentinel_;
+        size_t ids_pages_count_;
+        size_t ids_size_;
+    };
+
+    struct ListSentinel {
+        mem::Page sentinel_;
+        size_t pages_count_;
+        size_t size_;
+        size_t tombstones_;
+    };
+
+    DECLARE_LOGGER;
+    mem::PageAllocator::Ptr alloc_;
+    mem::PageList page_list_;
+    Header header_;
+    mem::Offset header_offset_ = 0;
+    std::optional<mem::PagedBlocks> directory_;
+    std::optional<mem::PagedArray<uint32_t>> ids_;
+    // Model is read by the first insertion or search
+    std::vector<float> model_;
+    util::AlignedVector<float> point_;
+    util::AlignedVector<float> residual_;
+
+    [[nodiscard]] mem::Offset FieldOffset(const auto& field) const {
+        return header_offset_ + static_cast<mem::Offset>(reinterpret_cast<const char*>(&field) -
+                                                         reinterpret_cast<const char*>(&header_));
+    }
+
+    template <typename T>
+    void WriteField(const T& field) {
+        alloc_->GetFile()->Write<T>(field, FieldOffset(field));
+    }
+
+    [[nodiscard]] size_t SubDimension() const {
+        return header_.dimension_ / header_.subspaces_;
+    }
+
+    [[nodiscard]] size_t EntrySize() const {
+        return sizeof(ts::ObjectId) + header_.subspaces_;
+    }
+
+    [[nodiscard]] const float* Centroid(size_t list) const {
+        return model_.data() + list * header_.dimension_;
+    }
+
+    [[nodiscard]] const float* Codebook(size_t subspace) const {
+        return model_.data() + header_.lists_ * header_.dimension_ +
+               subspace * header_.codes_ * SubDimension();
+    }
+
+    [[nodiscard]] mem::PagedBlocks List(size_t list) {
+        return mem::PagedBlocks("Ivf_List", alloc_, directory_->GetBlockOffset(list), EntrySize(),
+                                LOGGER);
+    }
+
+    [[nodiscard]] mem::PageList ModelList() {
+        return mem::PageList("Ivf_Model", alloc_->GetFile(), FieldOffset(header_.model_sentinel_),
+                             LOGGER);
+    }
+
+    void Open() {
+        auto& file = alloc_->GetFile();
+        header_offset_ = mem::GetOffset(page_list_.Front(), sizeof(mem::Page), file);
+        header_ = file->Read<Header>(header_offset_);
+        directory_.emplace("Ivf_Directory", alloc_, FieldOffset(header_.directory_sentinel_),
+                           sizeof(ListSentinel), LOGGER);
+        ids_.emplace("Ivf_Ids", alloc_, FieldOffset(header_.ids_sentinel_), LOGGER);
+    }
+
+    void WriteModel() {
+        auto& file = alloc_->GetFile();
+        auto model_list = ModelList();
+        auto data = reinterpret_cast<const char*>(model_.data());
+        auto size = model_.size() * sizeof(float);
+        auto capacity = alloc_->GetPageSize() - sizeof(mem::Page);
+        for (size_t written = 0; written < size; written += capacity) {
+            auto chunk_size = std::min(capacity, size - written);
+            model_list.PushBack(alloc_->AllocatePage());
+            auto page = mem::ReadPage(mem::Page(model_list.Back()), file);
+            page.type_ = mem::PageType::kVectorIndex;
+            page.free_offset_ = static_cast<mem::PageOffset>(sizeof(mem::Page) + chunk_size);
+            page.actual_size_ = chunk_size;
+            mem::WritePage(page, file);
+            file->WriteBuffer(data + written, mem::GetOffset(page.index_, sizeof(mem::Page), file),
+                              chunk_size);
+        }
+    }
+
+    void ReadModel() {
+        if (!model_.empty()) {
+            return;
+        }
+        auto& file = alloc_->GetFile();
+        model_.resize((header_.lists_ + header_.codes_) * header_.dimension_);
+        auto data = reinterpret_cast<char*>(model_.data());
+        size_t read = 0;
+        for (auto& page : ModelList()) {
+            if (read + page.actual_size_ > model_.size() * sizeof(float)) {
+                throw error::StructureError("Invalid vector index model");
+            }
+            file->ReadBuffer(data + read, mem::GetOffset(page.index_, sizeof(mem::Page), file),
+                             page.actual_size_);
+            read += page.actual_size_;
+        }
+        if (read != model_.size() * sizeof(float)) {
+            throw error::StructureError("Invalid vector index model");
+        }
+    }
+
+    // Copy of the vector that is normalized for the cosine
+    const float* Prepare(const float* vector, util::AlignedVector<float>& buffer) const {
+        buffer.assign(vector, vector + header_.dimension_);
+        if (header_.metric_ == Metric::kCosine) {
+            auto norm = std::sqrt(util::simd::Dot(buffer.data(), buffer.data(), buffer.size()));
+            if (norm != 0) {
+                for (auto& value : buffer) {
+                    value /= norm;
+                }
+            }
+        }
+        return buffer.data();
+    }
+
+public:
+    IvfPqIndex(mem::PageAllocator::Ptr& alloc, mem::Offset sentinel_offset,
+               DEFAULT_LOGGER(logger))
+        : LOGGER(logger),
+          alloc_(alloc),
+          page_list_("Quantized_Index", alloc_->GetFile(), sentinel_offset, LOGGER),
+          header_{} {
+        if (!page_list_.IsEmpty()) {
+            Open();
+        }
+    }
+
+    [[nodiscard]] bool IsBuilt() const {
+        return directory_.has_value();
+    }
+
+    [[nodiscard]] std::string_view Field() const {
+        return std::string_view(header_.field_);
+    }
+
+    [[nodiscard]] size_t Tombstones() const {
+        return header_.tombstones_;
+    }
+
+    // Centroids and codebooks are trained on the sample of the vectors of the field
+    void Create(std::string_view field, size_t dimension, const IvfPqParams& params,
+                Metric metric, const std::vector<float>& sample) {
+        if (IsBuilt()) {
+            throw error::BadArgument("Quantized index already exists");
+        }
+        if (field.size() >= kMaxFieldLength) {
+            throw error::NotImplemented("Too long field path");
+        }
+        if (params.lists_ == 0 || params.probes_ == 0 || params.subspaces_ == 0 ||
+            dimension % params.subspaces_ != 0) {
+            throw error::BadArgument("Invalid index parameters");
+        }
+        auto count = sample.size() / dimension;
+        if (count == 0) {
+            throw error::BadArgument("No vectors to train the index");
+        }
+        header_ = Header{};
+        header_.dimension_ = static_cast<uint32_t>(dimension);
+        header_.lists_ = static_cast<uint32_t>(std::min(params.lists_, count));
+        header_.subspaces_ = static_cast<uint32_t>(params.subspaces_);
+        header_.codes_ = static_cast<uint32_t>(std::min(kMaxCodes, count));
+        header_.probes_ = static_cast<uint32_t>(params.probes_);
+        header_.metric_ = metric;
+        std::memcpy(header_.field_, field.data(), field.size());
+        for (auto sentinel : {&header_.model_sentinel_, &header_.directory_sentinel_,
+                              &header_.ids_sentinel_}) {
+            *sentinel = mem::Page(mem::kSentinelIndex);
+            sentinel->type_ = mem::PageType::kSentinel;
+        }
+        if (EntrySize() > alloc_->GetPageSize() - sizeof(mem::Page)) {
+            throw error::NotImplemented("Too many subspaces for the index");
+        }
+
+        std::vector<float> points(sample.size());
+        for (size_t i = 0; i < count; ++i) {
+            Prepare(sample.data() + i * dimension, point_);
+            std::copy(point_.begin(), point_.end(), points.begin() + i * dimension);
+        }
+        std::mt19937_64 generator(count);
+        model_ = TrainKMeans(points, dimension, header_.lists_, params.iterations_, generator);
+        auto sub_dimension = SubDimension();
+        std::vector<std::vector<float>> parts(header_.subspaces_,
+                                              std::vector<float>(count * sub_dimension));
+        for (size_t i = 0; i < count; ++i) {
+            auto point = points.data() + i * dimension;
+            auto centroid = Centroid(ClosestCentroid(model_.data(), header_.lists_, dimension,
+                                                     point));
+            for (size_t j = 0; j < dimension; ++j) {
+                parts[j / sub_dimension][i * sub_dimension + j % sub_dimension] =
+                    point[j] - centroid[j];
+            }
+        }
+        for (auto& part : parts) {
+            auto codebook =
+                TrainKMeans(part, sub_dimension, header_.codes_, params.iterations_, generator);
+            model_.insert(model_.end(), codebook.begin(), codebook.end());
+        }
+
+        auto& file = alloc_->GetFile();
+        page_list_.PushBack(alloc_->AllocatePage());
+        auto page = mem::ReadPage(mem::Page(page_list_.Back()), file);
+        page.type_ = mem::PageType::kVectorIndex;
+        mem::WritePage(page, file);
+        file->Write<Header>(header_, mem::GetOffset(page.index_, sizeof(mem::Page), file));
+        Open();
+        WriteModel();
+        auto sentinel = ListSentinel{mem::Page(mem::kSentinelIndex), 0, 0, 0};
+        sentinel.sentinel_.type_ = mem::PageType::kSentinel;
+        for (size_t list = 0; list < header_.lists_; ++list) {
+            file->Write<ListSentinel>(sentinel, directory_->GetBlockOffset(directory_->PushBack()));
+        }
+        INFO("Quantized index created on ", field, ", lists: ", header_.lists_);
+    }
+
+    void Insert(ts::ObjectId id, const float* vector) {
+        ReadModel();
+        auto point = Prepare(vector, point_);
+        auto list = ClosestCentroid(model_.data(), header_.lists_, header_.dimension_, point);
+        auto centroid = Centroid(list);
+        residual_.resize(header_.dimension_);
+        for (size_t j = 0; j < header_.dimension_; ++j) {
+            residual_[j] = point[j] - centroid[j];
+        }
+
+        std::vector<char> entry(EntrySize());
+        std::memcpy(entry.data(), &id, sizeof(ts::ObjectId));
+        auto sub_dimension = SubDimension();
+        for (size_t subspace = 0; subspace < header_.subspaces_; ++subspace) {
+            entry[sizeof(ts::ObjectId) + subspace] = static_cast<char>(
+                ClosestCentroid(Codebook(subspace), header_.codes_, sub_dimension,
+                                residual_.data() + subspace * sub_dimension));
+        }
+        auto table = List(list);
+        alloc_->GetFile()->WriteBuffer(entry.data(), table.GetBlockOffset(table.PushBack()),
+                                       entry.size());
+
+        ids_->Extend(id + 1, 0);
+        ids_->Set(id, static_cast<uint32_t>(list + 1));
+    }
+
+    // Vector is taken from the serialized node
+    void Insert(const ts::Class::Ptr& node_class, ts::ObjectId id, std::string_view record) {
+        auto field = VectorField(node_class, Field());
+        thread_local util::AlignedVector<float> buffer;
+        ts::VisitElement(field.GetClass().Element(), [&](auto type) {
+            using E = typename decltype(type)::type;
+            Insert(id, ToFloats<E>(field.Locate(record), header_.dimension_, buffer));
+        });
+    }
+
+    // Live entries are moved to the front of the list, the pages left empty are freed
+    void CompactList(size_t list) {
+        auto& file = alloc_->GetFile();
+        auto table = List(list);
+        auto entry_size = EntrySize();
+        std::vector<char> live;
+        table.VisitPages([&](mem::Offset offset, size_t count) {
+            auto entries = file->ReadVector<char>(offset, count * entry_size);
+            for (size_t i = 0; i < count; ++i) {
+                ts::ObjectId id;
+                std::memcpy(&id, entries.data() + i * entry_size, sizeof(ts::ObjectId));
+                if (id != kRemoved) {
+                    live.insert(live.end(), entries.begin() + i * entry_size,
+                                entries.begin() + (i + 1) * entry_size);
+                }
+            }
+        });
+        auto live_count = live.size() / entry_size;
+        size_t written = 0;
+        table.VisitPages([&](mem::Offset offset, size_t count) {
+            auto chunk = std::min(count, live_count - written);
+            if (chunk != 0) {
+                file->WriteBuffer(live.data() + written * entry_size, offset, chunk * entry_size);
+            }
+            written += chunk;
+        });
+        header_.tombstones_ -= table.Size() - live_count;
+        table.Resize(live_count);
+        file->Write<size_t>(0, directory_->GetBlockOffset(list) +
+                                   static_cast<mem::Offset>(offsetof(ListSentinel, tombstones_)));
+    }
+
+    // Entries are marked in place, every list is read once for all of its ids
+    void Remove(const std::vector<ts::ObjectId>& ids) {
+        std::unordered_map<size_t, std::unordered_set<ts::ObjectId>> removed;
+        for (auto id : ids) {
+            if (id < ids_->Size()) {
+                if (auto list = ids_->Get(id); list != 0) {
+                    removed[list - 1].insert(id);
+                    ids_->Set(id, 0);
+                }
+            }
+        }
+        auto& file = alloc_->GetFile();
+        for (auto& [list, list_ids] : removed) {
+            auto table = List(list);
+            size_t marked = 0;
+            table.VisitPages([&](mem::Offset offset, size_t count) {
+                auto entries = file->ReadVector<char>(offset, count * EntrySize());
+                for (size_t i = 0; i < count; ++i) {
+                    ts::ObjectId id;
+                    std::memcpy(&id, entries.data() + i * EntrySize(), sizeof(ts::ObjectId));
+                    if (list_ids.contains(id)) {
+                        file->Write<ts::ObjectId>(
+                            kRemoved, offset + static_cast<mem::Offset>(i * EntrySize()));
+                        ++marked;
+                    }
+                }
+            });
+            header_.tombstones_ += marked;
+            auto offset = directory_->GetBlockOffset(list) +
+                          static_cast<mem::Offset>(offsetof(ListSentinel, tombstones_));
+            auto tombstones = file->Read<size_t>(offset) + marked;
+            if (tombstones * kCompactShare >= table.Size()) {
+                CompactList(list);
+            } else {
+                file->Write<size_t>(tombstones, offset);
+            }
+        }
+        WriteField(header_.tombstones_);
+    }
+
+    // Distances are approximate, the lists closest to the query are scanned
+    [[nodiscard]] std::vector<Neighbor> Search(std::span<const float> query, size_t k,
+                                               std::optional<size_t> probes = std::nullopt) {
+        if (query.size() != header_.dimension_) {
+            throw error::BadArgument("Query dimension doesn't match the index");
+        }
+        ReadModel();
+        auto point = Prepare(query.data(), point_);
+        auto dimension = header_.dimension_;
+        auto inner_product = header_.metric_ == Metric::kInnerProduct;
+
+        std::vector<std::pair<float, size_t>> lists(header_.lists_);
+        for (size_t list = 0; list < lists.size(); ++list) {
+            lists[list] = {inner_product ? -util::simd::Dot(point, Centroid(list), dimension)
+                                         : util::simd::L2(point, Centroid(list), dimension),
+                           list};
+        }
+        auto probes_count = std::min(probes.value_or(header_.probes_), lists.size());
+        std::partial_sort(lists.begin(), lists.begin() + static_cast<std::ptrdiff_t>(probes_count),
+                          lists.end());
+
+        // Table of the inner product doesn't depend on the list, the one of L2 is built for the
+        // residual of the query
+        auto sub_dimension = SubDimension();
+        auto scale = header_.metric_ == Metric::kCosine ? 0.5f : 1.f;
+        thread_local util::AlignedVector<float> table;
+        auto fill_table = [&](const float* target) {
+            table.resize(header_.subspaces_ * header_.codes_);
+            for (size_t subspace = 0; subspace < header_.subspaces_; ++subspace) {
+                auto part = target + subspace * sub_dimension;
+                auto codebook = Codebook(subspace);
+                for (size_t code = 0; code < header_.codes_; ++code) {
+                    auto centroid = codebook + code * sub_dimension;
+                    table[subspace * header_.codes_ + code] =
+                        inner_product ? -util::simd::Dot(part, centroid, sub_dimension)
+                                      : scale * util::simd::L2(part, centroid, sub_dimension);
+                }
+            }
+        };
+        if (inner_product) {
+            fill_table(point);
+        }
+
+        thread_local TopK top;
+        top.Reset(k);
+        auto& file = alloc_->GetFile();
+        auto entry_size = EntrySize();
+        for (size_t probe = 0; probe < probes_count; ++probe) {
+            auto [list_distance, list] = lists[probe];
+            auto base = inner_product ? list_distance : 0.f;
+            if (!inner_product) {
+                residual_.resize(dimension);
+                for (size_t j = 0; j < dimension; ++j) {
+                    residual_[j] = point[j] - Centroid(list)[j];
+                }
+                fill_table(residual_.data());
+            }
+            List(list).VisitPages([&](mem::Offset offset, size_t count) {
+                auto entries = file->ReadVector<uint8_t>(offset, count * entry_size);
+                for (size_t i = 0; i < count; ++i) {
+                    auto entry = entries.data() + i * entry_size;
+                    ts::ObjectId id;
+                    std::memcpy(&id, entry, sizeof(ts::ObjectId));
+                    if (id == kRemoved) {
+                        continue;
+                    }
+                    auto codes = entry + sizeof(ts::ObjectId);
+                    auto distance = base;
+                    for (size_t subspace = 0; subspace < header_.subspaces_; ++subspace) {
+                        distance += table[subspace * header_.codes_ + codes[subspace]];
+                    }
+                    top.Push(id, distance);
+                }
+            });
+        }
+        return top.Take();
+    }
+
+    void Drop() {
+        if (!IsBuilt()) {
+            return;
+        }
+        for (size_t list = 0; list < directory_->Size(); ++list) {
+            List(list).Drop();
+        }
+        directory_->Drop();
+        ids_->Drop();
+        auto model_list = ModelList();
+        while (!model_list.IsEmpty()) {
+            auto index = model_list.Back();
+            model_list.PopBack();
+            alloc_->FreePage(index);
+        }
+        directory_.reset();
+        ids_.reset();
+        model_.clear();
+        auto index = page_list_.Back();
+        page_list_.PopBack();
+        alloc_->FreePage(index);
+        header_ = Header{};
+    }
+};
+
+}  // namespace db
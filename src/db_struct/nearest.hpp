@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "aligned.hpp"
+#include "new.hpp"
+#include "simd.hpp"
+
+namespace db {
+
+enum class Metric { kL2, kInnerProduct, kCosine };
+
+struct Neighbor {
+    ts::ObjectId id_;
+    float distance_;
+};
+
+// Bit per id, nodes with unset bits are skipped by the search
+using IdBitmap = std::vector<bool>;
+
+// Smaller distance is closer for every metric: squared L2, negated inner product and one minus
+// the cosine of the angle
+class Distance {
+    Metric metric_;
+    std::span<const float> query_;
+    float query_norm_;
+
+public:
+    Distance(Metric metric, std::span<const float> query)
+        : metric_(metric),
+          query_(query),
+          query_norm_(std::sqrt(util::simd::Dot(query.data(), query.data(), query.size()))) {
+    }
+
+    [[nodiscard]] float operator()(const float* values) const {
+        switch (metric_) {
+            case Metric::kL2:
+                return util::simd::L2(query_.data(), values, query_.size());
+            case Metric::kInnerProduct:
+                return -util::simd::Dot(query_.data(), values, query_.size());
+            case Metric::kCosine: {
+                auto norm = std::sqrt(util::simd::Dot(values, values, query_.size()));
+                if (norm == 0 || query_norm_ == 0) {
+                    return 1;
+                }
+                return 1 - util::simd::Dot(query_.data(), values, query_.size()) /
+                               (query_norm_ * norm);
+            }
+        }
+        throw error::BadArgument("Unknown metric");
+    }
+};
+
+// The k closest found so far in the max-heap, the farthest of them is replaced by a closer one
+class TopK {
+    size_t k_ = 0;
+    std::vector<Neighbor> heap_;
+
+    [[nodiscard]] static bool Closer(const Neighbor& lhs, const Neighbor& rhs) {
+        return lhs.distance_ < rhs.distance_;
+    }
+
+public:
+    void Reset(size_t k) {
+        k_ = k;
+        heap_.clear();
+        heap_.reserve(k);
+    }
+
+    [[nodiscard]] size_t Size() const {
+        return heap_.size();
+    }
+
+    // Distance that should be beaten to get into the heap
+    [[nodiscard]] float Bound() const {
+        return heap_.size() < k_ ? std::numeric_limits<float>::infinity()
+                                 : heap_.front().distance_;
+    }
+
+    void Push(ts::ObjectId id, float distance) {
+        if (distance >= Bound() || k_ == 0) {
+            return;
+        }
+        if (heap_.size() == k_) {
+            std::pop_heap(heap_.begin(), heap_.end(), Closer);
+            heap_.pop_back();
+        }
+        heap_.push_back(Neighbor{id, distance});
+        std::push_heap(heap_.begin(), heap_.end(), Closer);
+    }
+
+    // Neighbors from the closest, the heap is left empty
+    [[nodiscard]] std::vector<Neighbor> Take() {
+        std::sort_heap(heap_.begin(), heap_.end(), Closer);
+        return std::exchange(heap_, {});
+    }
+};
+
+// Vector field of the class resolved once before the scan, empty path is the node itself
+class VectorField {
+    const ts::VectorClass* class_;
+    const ts::Layout* layout_ = nullptr;
+    size_t index_ = 0;
+
+public:
+    VectorField(const ts::Class::Ptr& node_class, std::string_view path) {
+        const ts::Class* field = node_class.get();
+        if (!path.empty()) {
+            if (node_class->GetKind() != ts::kStructKind) {
+                throw error::BadArgument("No such field: " + std::string(path));
+            }
+            layout_ = &static_cast<const ts::StructClass*>(field)->GetLayout();
+            auto index = layout_->Find(path);
+            if (!index.has_value()) {
+                throw error::BadArgument("No such field: " + std::string(path));
+            }
+            index_ = index.value();
+            field = layout_->Get(index_).class_;
+        }
+        if (field->GetKind() != ts::kVectorKind) {
+            throw error::TypeError("Field isn't a vector");
+        }
+        class_ = static_cast<const ts::VectorClass*>(field);
+    }
+
+    [[nodiscard]] const ts::VectorClass& GetClass() const {
+        return *class_;
+    }
+
+    [[nodiscard]] const char* Locate(std::string_view record) const {
+        auto offset = layout_ == nullptr ? 0 : layout_->GetOffset(index_, record);
+        if (offset + class_->Size().value() > record.size()) {
+            throw error::StructureError("Field is out of the node");
+        }
+        return record.data() + offset;
+    }
+};
+
+// Floats aligned in the record are used in place, other vectors are converted into the buffer
+template <ts::VectorElement T>
+[[nodiscard]] const float* ToFloats(const char* data, size_t dimension,
+                                    util::AlignedVector<float>& buffer) {
+    if constexpr (std::is_same_v<T, float>) {
+        if (reinterpret_cast<uintptr_t>(data) % alignof(float) == 0) {
+            return reinterpret_cast<const float*>(data);
+        }
+        buffer.resize(dimension);
+        std::memcpy(buffer.data(), data, dimension * sizeof(float));
+    } else {
+        buffer.resize(dimension);
+        for (size_t i = 0; i < dimension; ++i) {
+            T value;
+            std::memcpy(&value, data + i * sizeof(T), sizeof(T));
+            buffer[i] = static_cast<float>(value);
+        }
+    }
+    return buffer.data();
+}
+
+}  // namespace db
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <cstring>
+#include <optional>
+#include <string_view>
 #include <variant>
+#include <vector>
 
 #include "mem.hpp"
 #include "new.hpp"
@@ -22,6 +26,21 @@ enum class ObjectState { kFree, kValid, kInvalid };
     }
 }
 
+// Big values are moved into the chain of overflow pages and the record keeps only the sentinel of
+// this chain, such records are marked with the different magic
+constexpr mem::Magic kOverflowMask = 0x0F0F'0000'0000'0000;
+
+[[nodiscard]] constexpr mem::Magic OverflowMagic(mem::Magic magic) {
+    return magic ^ kOverflowMask;
+}
+
+struct Overflow {
+    mem::Page sentinel_;
+    // Count of pages in the chain, must follow the sentinel as in every page list
+    size_t pages_count_;
+    size_t size_;
+};
+
 class Node {
 private:
     mem::Magic magic_;
@@ -29,6 +48,72 @@ private:
     std::variant<mem::PageOffset, ts::ObjectId> meta_;
     ts::Object::Ptr data_;
     ObjectState state_;
+    std::optional<Overflow> overflow_ = std::nullopt;
+
+    [[nodiscard]] std::vector<char> ReadOverflow(mem::File::Ptr& file) const {
+        std::vector<char> buffer;
+        buffer.reserve(overflow_->size_);
+        auto index = overflow_->sentinel_.previous_page_index_;
+        while (index != mem::kSentinelIndex) {
+            auto page = mem::ReadPage(mem::Page(index), file);
+            auto chunk = file->ReadVector<char>(mem::GetOffset(index, sizeof(mem::Page), file),
+                                                page.free_offset_ - sizeof(mem::Page));
+            buffer.insert(buffer.end(), chunk.begin(), chunk.end());
+            index = page.previous_page_index_;
+        }
+        return buffer;
+    }
+
+    // Parses the magic and the meta of the record, returns the magic to tell overflowed records
+    mem::Magic ReadHeader(const char* record) {
+        mem::Magic magic;
+        std::memcpy(&magic, record, sizeof(mem::Magic));
+        if (magic == magic_ || magic == OverflowMagic(magic_)) {
+            state_ = ObjectState::kValid;
+            ts::ObjectId id;
+            std::memcpy(&id, record + sizeof(mem::Magic), sizeof(ts::ObjectId));
+            meta_ = id;
+        } else if (magic == ~magic_) {
+            state_ = ObjectState::kFree;
+            mem::PageOffset next;
+            std::memcpy(&next, record + sizeof(mem::Magic), sizeof(mem::PageOffset));
+            meta_ = next;
+        } else {
+            state_ = ObjectState::kInvalid;
+        }
+        return magic;
+    }
+
+    void ReadData(mem::File::Ptr& file, const char* data, mem::Magic read_magic) {
+        if (read_magic == magic_) {
+            overflow_ = std::nullopt;
+            data_->Read(data);
+        } else {
+            Overflow overflow;
+            std::memcpy(&overflow, data, sizeof(Overflow));
+            overflow_ = overflow;
+            data_->Read(ReadOverflow(file).data());
+        }
+    }
+
+    // Records of fixed size classes are read with one call, the data of the others is read after
+    // the header since its size is unknown
+    void ReadRecord(const ts::Class::Ptr& data_class, mem::File::Ptr& file, mem::Offset offset) {
+        auto data_size = data_class->Size();
+        auto& record =
+            ts::ScratchBuffer(kHeaderSize + std::max(data_size.value_or(0), sizeof(Overflow)));
+        file->ReadBuffer(record.data(), offset, record.size());
+        auto read_magic = ReadHeader(record.data());
+        if (state_ != ObjectState::kValid) {
+            return;
+        }
+        if (read_magic == magic_ && !data_size.has_value()) {
+            overflow_ = std::nullopt;
+            data_->Read(file, offset + kHeaderSize);
+        } else {
+            ReadData(file, record.data() + kHeaderSize, read_magic);
+        }
+    }
 
 public:
     using Ptr = util::Ptr<Node>;
@@ -38,12 +123,38 @@ public:
         : magic_(magic), meta_(id), data_(data), state_(ObjectState::kValid) {
     }
 
+    static constexpr size_t kHeaderSize = sizeof(mem::Magic) + sizeof(ts::ObjectId);
+
+    [[nodiscard]] static mem::Offset GetOverflowSentinelOffset(mem::Offset record_offset) {
+        return record_offset + static_cast<mem::Offset>(sizeof(mem::Magic) + sizeof(ts::ObjectId));
+    }
+
+    [[nodiscard]] static constexpr size_t OverflowRecordSize() {
+        return sizeof(mem::Magic) + sizeof(ts::ObjectId) + sizeof(Overflow);
+    }
+
+    // Record will keep only the empty chain, pages should be linked into it after the record is
+    // written
+    Node& MoveToOverflow() {
+        auto sentinel = mem::Page(mem::kSentinelIndex);
+        sentinel.type_ = mem::PageType::kSentinel;
+        overflow_ = Overflow{sentinel, 0, data_->Size()};
+        return *this;
+    }
+
+    [[nodiscard]] bool IsOverflowed() const {
+        return overflow_.has_value();
+    }
+
     size_t Size() const {
         switch (state_) {
             case ObjectState::kFree: {
                 return sizeof(mem::Magic) + sizeof(mem::PageOffset);
             }
             case ObjectState::kValid:
+                if (overflow_.has_value()) {
+                    return OverflowRecordSize();
+                }
                 return sizeof(mem::Magic) + sizeof(ts::ObjectId) + data_->Size();
             case ObjectState::kInvalid:
                 throw error::BadArgument("Invalid object has no size");
@@ -52,40 +163,46 @@ public:
         }
     }
 
-    mem::Offset Write(mem::File::Ptr& file, mem::Offset offset) const {
+    // Serializes the whole record, returns the number of written bytes
+    size_t Write(char* buffer) const {
         switch (state_) {
-            case ObjectState::kFree:
-                file->Write<mem::Magic>(~magic_, offset);
-                offset += sizeof(mem::Magic);
-                return file->Write(std::get<mem::PageOffset>(meta_), offset);
-
-            case ObjectState::kValid:
-                file->Write<mem::Magic>(magic_, offset);
-                offset += sizeof(mem::Magic);
-                file->Write(std::get<ts::ObjectId>(meta_), offset);
-                offset += sizeof(ts::ObjectId);
-                return data_->Write(file, offset);
+            case ObjectState::kFree: {
+                auto magic = ~magic_;
+                std::memcpy(buffer, &magic, sizeof(mem::Magic));
+                std::memcpy(buffer + sizeof(mem::Magic), &std::get<mem::PageOffset>(meta_),
+                            sizeof(mem::PageOffset));
+                return sizeof(mem::Magic) + sizeof(mem::PageOffset);
+            }
+            case ObjectState::kValid: {
+                auto magic = overflow_.has_value() ? OverflowMagic(magic_) : magic_;
+                std::memcpy(buffer, &magic, sizeof(mem::Magic));
+                std::memcpy(buffer + sizeof(mem::Magic), &std::get<ts::ObjectId>(meta_),
+                            sizeof(ts::ObjectId));
+                if (overflow_.has_value()) {
+                    std::memcpy(buffer + kHeaderSize, &overflow_.value(), sizeof(Overflow));
+                    return OverflowRecordSize();
+                }
+                return kHeaderSize + data_->Write(buffer + kHeaderSize);
+            }
             case ObjectState::kInvalid:
                 throw error::BadArgument("Trying to write invalid object");
             default:
                 throw error::RuntimeError("Invalid state");
         }
     }
-    void Read(mem::File::Ptr& file, mem::Offset offset) {
-        auto magic = file->Read<mem::Magic>(offset);
-        offset += sizeof(mem::Magic);
 
-        if (magic == magic_) {
-            state_ = ObjectState::kValid;
-            meta_ = file->Read<ts::ObjectId>(offset);
-            offset += sizeof(ts::ObjectId);
-            data_->Read(file, offset);
-        } else if (magic == ~magic_) {
-            state_ = ObjectState::kFree;
-            meta_ = file->Read<mem::PageOffset>(offset);
-        } else {
-            state_ = ObjectState::kInvalid;
+    // Record is serialized into the scratch buffer and reaches the file with one write
+    mem::Offset Write(mem::File::Ptr& file, mem::Offset offset) const {
+        auto& record = ts::ScratchBuffer(Size());
+        Write(record.data());
+        file->WriteBuffer(record.data(), offset, record.size());
+        return offset + static_cast<mem::Offset>(record.size());
+    }
+    void Read(mem::File::Ptr& file, mem::Offset offset) {
+        if (!data_) {
+            throw error::BadArgument("Node has no class to read the data");
         }
+        ReadRecord(data_->GetClass(), file, offset);
     }
     [[nodiscard]] std::string ToString() const {
         return std::string("NODE: ")
@@ -101,47 +218,24 @@ public:
             .append(" } ");
     }
 
-    Node(mem::Magic magic, ts::Class::Ptr data_class, mem::File::Ptr& file, mem::Offset offset)
-        : magic_(magic) {
+    // Creates the default object of the class to read the data into
+    [[nodiscard]] static ts::Object::Ptr NewObject(const ts::Class::Ptr& data_class) {
+        return ts::DefaultNewObject(data_class);
+    }
 
-        auto read_magic = file->Read<mem::Magic>(offset);
-        offset += sizeof(mem::Magic);
+    Node(mem::Magic magic, const ts::Class::Ptr& data_class, mem::File::Ptr& file,
+         mem::Offset offset)
+        : magic_(magic), data_(NewObject(data_class)) {
+        ReadRecord(data_class, file, offset);
+    }
 
-        if (read_magic == magic_) {
-            state_ = ObjectState::kValid;
-            meta_ = file->Read<ts::ObjectId>(offset);
-            offset += sizeof(ts::ObjectId);
-
-            if (util::Is<ts::StructClass>(data_class)) {
-                data_ =
-                    ts::ReadNew<ts::Struct>(util::As<ts::StructClass>(data_class), file, offset);
-            } else if (util::Is<ts::StringClass>(data_class)) {
-                data_ =
-                    ts::ReadNew<ts::String>(util::As<ts::StringClass>(data_class), file, offset);
-            } else if (util::Is<ts::RelationClass>(data_class)) {
-                data_ = ts::ReadNew<ts::Relation>(util::As<ts::RelationClass>(data_class), file,
-                                                  offset);
-            } else {
-
-#define DDB_CREATE_PRIMITIVE(P)                                                                  \
-    else if (util::Is<ts::PrimitiveClass<P>>(data_class)) {                                      \
-        data_ = ts::ReadNew<ts::Primitive<P>>(util::As<ts::PrimitiveClass<P>>(data_class), file, \
-                                              offset);                                           \
-    }
-
-                if (false) {
-                }
-                DDB_PRIMITIVE_GENERATOR(DDB_CREATE_PRIMITIVE)
-                else {
-                    throw error::TypeError("Class can't be turned in Node");
-                }
-#undef CREATE_PRIMITIVE
-            }
-        } else if (read_magic == ~magic_) {
-            state_ = ObjectState::kFree;
-            meta_ = file->Read<mem::PageOffset>(offset);
-        } else {
-            state_ = ObjectState::kInvalid;
+    // Record is already in memory, the file is touched only for the overflow pages
+    Node(mem::Magic magic, const ts::Class::Ptr& data_class, mem::File::Ptr& file,
+         std::string_view record)
+        : magic_(magic), data_(NewObject(data_class)) {
+        auto read_magic = ReadHeader(record.data());
+        if (state_ == ObjectState::kValid) {
+            ReadData(file, record.data() + kHeaderSize, read_magic);
         }
     }
 
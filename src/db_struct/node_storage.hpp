@@ -1,11 +1,35 @@
 #pragma once
 
+#include <optional>
+
 #include "allocator.hpp"
 #include "class_storage.hpp"
+#include "hnsw.hpp"
+#include "ivf_pq.hpp"
 #include "logger.hpp"
+#include "paged_array.hpp"
+#include "statistics.hpp"
 
 namespace db {
 
+// Location of the record stays the same while the node lives, records are moved only inside their
+// pages and the pages themselves are tracked by the table after the compaction of the file. Any
+// page could hold the nodes after the compaction, so the index that no page gets marks no node
+struct NodeLocation {
+    uint64_t index_ : 48;
+    uint64_t slot_ : 16;
+};
+
+constexpr NodeLocation kNoLocation = NodeLocation{(uint64_t{1} << 48) - 1, 0};
+
+struct ClassStats {
+    size_t nodes_count_;
+    size_t live_bytes_;
+    size_t pages_count_;
+    std::optional<ts::ObjectId> min_id_;
+    std::optional<ts::ObjectId> max_id_;
+};
+
 class NodeStorage {
 protected:
     DECLARE_LOGGER;
@@ -13,6 +37,7 @@ protected:
     ClassStorage::Ptr class_storage_;
     mem::PageAllocator::Ptr alloc_;
     mem::PageList data_page_list_;
+    mem::PagedArray<NodeLocation> id_table_;
 
     mem::Page AllocatePage() {
         data_page_list_.PushBack(alloc_->AllocatePage());
@@ -52,14 +77,142 @@ protected:
         return mem::ClassHeader(index.value()).ReadClassHeader(alloc_->GetFile());
     }
 
+    void CountInsertion(mem::ClassHeader& header, ts::ObjectId id, size_t size) {
+        auto stats = header.stats_;
+        stats.min_id_ = stats.nodes_count_ == 0 ? id : std::min(stats.min_id_, id);
+        stats.max_id_ = stats.nodes_count_ == 0 ? id : std::max(stats.max_id_, id);
+        ++stats.nodes_count_;
+        stats.live_bytes_ += size;
+        header.WriteStats(alloc_->GetFile(), stats);
+    }
+
+    // Nodes added while the class has vector indices are inserted into them
+    template <ts::ObjectLike O>
+    void IndexNode(mem::ClassHeader& header, ts::ObjectId id, util::Ptr<O>& node) {
+        if (header.vector_index_pages_count_ == 0 && header.quantized_index_pages_count_ == 0) {
+            return;
+        }
+        auto& file = alloc_->GetFile();
+        auto& record = ts::ScratchBuffer(node->Size());
+        node->Write(record.data());
+        auto data = std::string_view(record.data(), record.size());
+        if (header.vector_index_pages_count_ != 0) {
+            HnswIndex(alloc_, header.GetVectorIndexSentinelOffset(file), LOGGER)
+                .Insert(nodes_class_, id, data);
+        }
+        if (header.quantized_index_pages_count_ != 0) {
+            IvfPqIndex(alloc_, header.GetQuantizedIndexSentinelOffset(file), LOGGER)
+                .Insert(nodes_class_, id, data);
+        }
+    }
+
+    // Removal visits every node, so the range of ids is collected from the nodes that are left
+    class RemovalStats {
+        mem::NodeStats stats_;
+
+    public:
+        RemovalStats() : stats_{0, 0, SIZE_MAX, 0} {
+        }
+
+        void Removed(size_t size) {
+            ++stats_.nodes_count_;
+            stats_.live_bytes_ += size;
+        }
+
+        void Kept(ts::ObjectId id) {
+            stats_.min_id_ = std::min(stats_.min_id_, id);
+            stats_.max_id_ = std::max(stats_.max_id_, id);
+        }
+
+        friend NodeStorage;
+    };
+
+    void CountRemoval(const RemovalStats& removal) {
+        auto header = GetHeader();
+        auto stats = header.stats_;
+        stats.nodes_count_ -= removal.stats_.nodes_count_;
+        stats.live_bytes_ -= removal.stats_.live_bytes_;
+        stats.min_id_ = removal.stats_.min_id_;
+        stats.max_id_ = removal.stats_.max_id_;
+        header.WriteStats(alloc_->GetFile(), stats);
+    }
+
+    // Ids are given in the increasing order, so the table grows by appending
+    void SetLocation(ts::ObjectId id, NodeLocation location) {
+        id_table_.Extend(id + 1, kNoLocation);
+        id_table_.Set(id, location);
+    }
+
+    void RemoveLocation(ts::ObjectId id) {
+        if (id < id_table_.Size()) {
+            id_table_.Set(id, kNoLocation);
+        }
+    }
+
+    // Tail of removed nodes is cut once after the removal, it's grown again by the next id
+    void TrimLocations() {
+        auto size = id_table_.Size();
+        if (size == 0 || id_table_.Get(size - 1).index_ != kNoLocation.index_) {
+            return;
+        }
+        auto locations = id_table_.ReadAll();
+        while (size > 0 && locations[size - 1].index_ == kNoLocation.index_) {
+            --size;
+        }
+        id_table_.Resize(size);
+    }
+
+    [[nodiscard]] std::optional<NodeLocation> GetLocation(ts::ObjectId id) {
+        if (id >= id_table_.Size()) {
+            return std::nullopt;
+        }
+        auto location = id_table_.Get(id);
+        if (location.index_ == kNoLocation.index_) {
+            return std::nullopt;
+        }
+        return location;
+    }
+
 public:
     template <ts::ClassLike C>
     NodeStorage(const util::Ptr<C>& nodes_class, ClassStorage::Ptr& class_storage,
                 mem::PageAllocator::Ptr& alloc, DEFAULT_LOGGER(logger))
-        : LOGGER(logger), nodes_class_(nodes_class), class_storage_(class_storage), alloc_(alloc) {
+        : LOGGER(logger),
+          nodes_class_(nodes_class),
+          class_storage_(class_storage),
+          alloc_(alloc),
+          id_table_("Id_Table", alloc_, GetHeader().GetIdTableSentinelOffset(alloc_->GetFile()),
+                    LOGGER) {
+
+        data_page_list_ =
+            mem::PageList(nodes_class->Name(), alloc_->GetFile(),
+                          GetHeader().GetNodeListSentinelOffset(alloc_->GetFile()), LOGGER);
+    }
+
+    [[nodiscard]] ClassStats Stats() {
+        auto header = GetHeader();
+        auto stats = ClassStats{header.stats_.nodes_count_, header.stats_.live_bytes_,
+                                data_page_list_.GetPagesCount(), std::nullopt, std::nullopt};
+        if (stats.nodes_count_ != 0) {
+            stats.min_id_ = header.stats_.min_id_;
+            stats.max_id_ = header.stats_.max_id_;
+        }
+        return stats;
+    }
+
+    [[nodiscard]] AnalysisStorage GetAnalysisStorage() {
+        return AnalysisStorage(alloc_, GetHeader().GetStatisticsSentinelOffset(alloc_->GetFile()),
+                               LOGGER);
+    }
+
+    [[nodiscard]] HnswIndex GetVectorIndex() {
+        return HnswIndex(alloc_, GetHeader().GetVectorIndexSentinelOffset(alloc_->GetFile()),
+                         LOGGER);
+    }
 
-        data_page_list_ = mem::PageList(nodes_class->Name(), alloc_->GetFile(),
-                                        GetHeader().GetNodeListSentinelOffset(), LOGGER);
+    [[nodiscard]] IvfPqIndex GetQuantizedIndex() {
+        return IvfPqIndex(alloc_, GetHeader().GetQuantizedIndexSentinelOffset(alloc_->GetFile()),
+                          LOGGER);
     }
 
     void Drop() {
@@ -71,6 +224,10 @@ public:
         for (auto index : indicies) {
             FreePage(index);
         }
+        id_table_.Drop();
+        GetAnalysisStorage().Drop();
+        GetVectorIndex().Drop();
+        GetQuantizedIndex().Drop();
     }
 };
 
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "aligned.hpp"
+#include "mem.hpp"
+#include "string.hpp"
+#include "struct_class.hpp"
+#include "vector_class.hpp"
+
+namespace db {
+
+// Copy of the page shared by the copies of the iterator, the memory is reused for the next page
+// unless another copy still looks at it
+class PageBuffer {
+    struct Data {
+        util::AlignedVector<char> page_;
+        // Values that can't be viewed in place are copied here until the buffer leaves the page
+        std::vector<util::AlignedVector<char>> copies_;
+    };
+
+    util::Ptr<Data> data_;
+    mem::PageIndex index_ = mem::kSentinelIndex;
+
+public:
+    void Load(mem::File::Ptr& file, mem::PageIndex index) {
+        if (index_ == index && data_) {
+            return;
+        }
+        if (!data_ || data_.use_count() > 1) {
+            data_ = util::MakePtr<Data>();
+            data_->page_.resize(file->GetPageSize());
+        }
+        data_->copies_.clear();
+        file->ReadBuffer(data_->page_.data(), mem::GetPageAddress(index, file),
+                         data_->page_.size());
+        index_ = index;
+    }
+
+    template <typename T>
+    [[nodiscard]] T Get(size_t offset) const {
+        T value;
+        std::memcpy(&value, data_->page_.data() + offset, sizeof(T));
+        return value;
+    }
+
+    [[nodiscard]] std::string_view View(size_t offset, size_t size) const {
+        return std::string_view(data_->page_.data() + offset, size);
+    }
+
+    // Aligned copy of the bytes, valid while the view of the page is
+    [[nodiscard]] const char* Copy(const char* data, size_t size) const {
+        auto& copy = data_->copies_.emplace_back(data, data + size);
+        return copy.data();
+    }
+};
+
+// Typed access to the serialized node without building its object, the view is valid until the
+// iterator that gave it leaves the page
+class NodeView {
+    ts::ObjectId id_;
+    const ts::Class* class_;
+    std::string_view data_;
+    const PageBuffer* page_;
+
+    template <typename T>
+    [[nodiscard]] T Read(size_t offset) const {
+        if (offset + sizeof(T) > data_.size()) {
+            throw error::StructureError("Field is out of the node");
+        }
+        T value;
+        std::memcpy(&value, data_.data() + offset, sizeof(T));
+        return value;
+    }
+
+    // Path is the chain of the field names separated by dots, empty path is the node itself
+    [[nodiscard]] std::pair<const ts::Class*, size_t> Find(std::string_view path) const {
+        if (path.empty()) {
+            return {class_, 0};
+        }
+        if (class_->GetKind() != ts::kStructKind) {
+            throw error::BadArgument("No such field: " + std::string(path));
+        }
+        auto& layout = static_cast<const ts::StructClass*>(class_)->GetLayout();
+        auto index = layout.Find(path);
+        if (!index.has_value()) {
+            throw error::BadArgument("No such field: " + std::string(path));
+        }
+        return {layout.Get(index.value()).class_, layout.GetOffset(index.value(), data_)};
+    }
+
+public:
+    NodeView(ts::ObjectId id, const ts::Class::Ptr& node_class, std::string_view data,
+             const PageBuffer& page)
+        : id_(id), class_(node_class.get()), data_(data), page_(&page) {
+    }
+
+    [[nodiscard]] ts::ObjectId Id() const {
+        return id_;
+    }
+
+    [[nodiscard]] std::string_view Data() const {
+        return data_;
+    }
+
+    template <typename T>
+    requires std::is_arithmetic_v<T>
+    [[nodiscard]] T Get(std::string_view path = {}) const {
+        auto [field_class, offset] = Find(path);
+        if (field_class->GetKind() != ts::PrimitiveKind<T>()) {
+            throw error::TypeError("Field isn't of the requested type");
+        }
+        return Read<T>(offset);
+    }
+
+    [[nodiscard]] std::string_view GetString(std::string_view path = {}) const {
+        auto [field_class, offset] = Find(path);
+        if (field_class->GetKind() != ts::kStringKind) {
+            throw error::TypeError("Field isn't a string");
+        }
+        auto size = Read<ts::String::SizeType>(offset);
+        if (offset + sizeof(ts::String::SizeType) + size > data_.size()) {
+            throw error::StructureError("Field is out of the node");
+        }
+        return data_.substr(offset + sizeof(ts::String::SizeType), size);
+    }
+
+    // Elements are viewed in place when the vector is aligned in the page, fields before it could
+    // break the alignment, then the elements are copied into the buffer of the page
+    template <ts::VectorElement T>
+    [[nodiscard]] std::span<const T> GetVector(std::string_view path = {}) const {
+        auto [field_class, offset] = Find(path);
+        if (field_class->GetKind() != ts::kVectorKind ||
+            static_cast<const ts::VectorClass*>(field_class)->Element() != ts::ElementTagOf<T>()) {
+            throw error::TypeError("Field isn't a vector of the requested type");
+        }
+        auto dimension = static_cast<const ts::VectorClass*>(field_class)->Dimension();
+        if (offset + dimension * sizeof(T) > data_.size()) {
+            throw error::StructureError("Field is out of the node");
+        }
+        auto data = data_.data() + offset;
+        if (reinterpret_cast<uintptr_t>(data) % alignof(T) != 0) {
+            data = page_->Copy(data, dimension * sizeof(T));
+        }
+        return std::span(reinterpret_cast<const T*>(data), dimension);
+    }
+};
+
+}  // namespace db
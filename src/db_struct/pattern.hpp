@@ -30,7 +30,7 @@ public:
 
     void AddRelation(ts::RelationClass::Ptr relation, std::function<bool(Node, Node)> predicate,
                      Pattern::Ptr pattern) {
-        if (relation->FromClass()->Serialize() == root_->Serialize()) {
+        if (relation->FromClass()->GetFingerprint() == root_->GetFingerprint()) {
             relations_.emplace_back(relation, predicate, pattern);
         }
     }
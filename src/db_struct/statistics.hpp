@@ -0,0 +1,363 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "allocator.hpp"
+#include "relation.hpp"
+#include "string.hpp"
+#include "struct.hpp"
+
+namespace db {
+
+// Numeric fields are compared as doubles, strings lexicographically
+using ColumnValue = std::variant<double, std::string>;
+
+// Distinct values are estimated by 2^10 one byte registers
+class HyperLogLog {
+    static constexpr size_t kPrecision = 10;
+    static constexpr size_t kRegisters = size_t{1} << kPrecision;
+
+    std::vector<uint8_t> registers_;
+
+    // Finalizer of splitmix64, std::hash of numbers is identity
+    [[nodiscard]] static uint64_t Mix(uint64_t hash) {
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111eb;
+        return hash ^ (hash >> 31);
+    }
+
+public:
+    HyperLogLog() : registers_(kRegisters, 0) {
+    }
+
+    void Add(const ColumnValue& value) {
+        auto hash = Mix(std::visit(
+            [](const auto& v) { return std::hash<std::decay_t<decltype(v)>>{}(v); }, value));
+        auto index = hash >> (64 - kPrecision);
+        auto rank = std::countl_zero((hash << kPrecision) | (uint64_t{1} << (kPrecision - 1))) + 1;
+        registers_[index] = std::max(registers_[index], static_cast<uint8_t>(rank));
+    }
+
+    [[nodiscard]] double Estimate() const {
+        double sum = 0;
+        size_t zeros = 0;
+        for (auto reg : registers_) {
+            sum += std::ldexp(1.0, -reg);
+            zeros += reg == 0;
+        }
+        auto m = static_cast<double>(kRegisters);
+        auto estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+        // Linear counting is more precise for small cardinalities
+        if (estimate <= 2.5 * m && zeros != 0) {
+            return m * std::log(m / static_cast<double>(zeros));
+        }
+        return estimate;
+    }
+};
+
+// Equi-depth histogram: every bucket between neighbouring bounds holds the same share of values
+struct ColumnStats {
+    std::string name_;
+    size_t values_count_;
+    double distinct_;
+    std::vector<ColumnValue> bounds_;
+
+    [[nodiscard]] double EstimateEqual(const ColumnValue& value) const {
+        if (bounds_.empty() || value < bounds_.front() || bounds_.back() < value) {
+            return 0;
+        }
+        return 1 / std::max(distinct_, 1.0);
+    }
+
+    [[nodiscard]] double EstimateLess(const ColumnValue& value) const {
+        if (bounds_.size() < 2) {
+            return bounds_.empty() || !(bounds_.front() < value) ? 0 : 1;
+        }
+        auto buckets = static_cast<double>(bounds_.size() - 1);
+        auto full = std::lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin();
+        if (full == 0) {
+            return 0;
+        }
+        if (static_cast<size_t>(full) == bounds_.size()) {
+            return 1;
+        }
+        // Value is assumed to be in the middle of its bucket
+        return (static_cast<double>(full) - 0.5) / buckets;
+    }
+};
+
+class ClassAnalysis {
+    std::vector<ColumnStats> columns_;
+
+    template <typename T>
+    static void Put(std::vector<char>& buffer, const T& value) {
+        auto size = buffer.size();
+        buffer.resize(size + sizeof(T));
+        std::memcpy(buffer.data() + size, &value, sizeof(T));
+    }
+
+    static void Put(std::vector<char>& buffer, const std::string& value) {
+        Put(buffer, value.size());
+        buffer.insert(buffer.end(), value.begin(), value.end());
+    }
+
+    template <typename T>
+    static T Take(const std::vector<char>& buffer, size_t& position) {
+        if (position + sizeof(T) > buffer.size()) {
+            throw error::StructureError("Corrupted statistics");
+        }
+        T value;
+        std::memcpy(&value, buffer.data() + position, sizeof(T));
+        position += sizeof(T);
+        return value;
+    }
+
+    static std::string TakeString(const std::vector<char>& buffer, size_t& position) {
+        auto size = Take<size_t>(buffer, position);
+        if (position + size > buffer.size()) {
+            throw error::StructureError("Corrupted statistics");
+        }
+        position += size;
+        return std::string(buffer.data() + position - size, size);
+    }
+
+public:
+    ClassAnalysis() = default;
+    explicit ClassAnalysis(std::vector<ColumnStats> columns) : columns_(std::move(columns)) {
+    }
+
+    [[nodiscard]] const std::vector<ColumnStats>& GetColumns() const {
+        return columns_;
+    }
+
+    [[nodiscard]] const ColumnStats& GetColumn(std::string_view name) const {
+        for (auto& column : columns_) {
+            if (column.name_ == name) {
+                return column;
+            }
+        }
+        throw error::BadArgument("No such column: " + std::string(name));
+    }
+
+    [[nodiscard]] std::vector<char> Serialize() const {
+        std::vector<char> buffer;
+        Put(buffer, columns_.size());
+        for (auto& column : columns_) {
+            Put(buffer, column.name_);
+            Put(buffer, column.values_count_);
+            Put(buffer, column.distinct_);
+            Put(buffer, column.bounds_.size());
+            for (auto& bound : column.bounds_) {
+                Put(buffer, static_cast<uint8_t>(bound.index()));
+                std::visit([&buffer](const auto& value) { Put(buffer, value); }, bound);
+            }
+        }
+        return buffer;
+    }
+
+    static ClassAnalysis Deserialize(const std::vector<char>& buffer) {
+        size_t position = 0;
+        std::vector<ColumnStats> columns(Take<size_t>(buffer, position));
+        for (auto& column : columns) {
+            column.name_ = TakeString(buffer, position);
+            column.values_count_ = Take<size_t>(buffer, position);
+            column.distinct_ = Take<double>(buffer, position);
+            column.bounds_.resize(Take<size_t>(buffer, position));
+            for (auto& bound : column.bounds_) {
+                if (Take<uint8_t>(buffer, position) == 0) {
+                    bound = Take<double>(buffer, position);
+                } else {
+                    bound = TakeString(buffer, position);
+                }
+            }
+        }
+        return ClassAnalysis(std::move(columns));
+    }
+};
+
+// Values of a column are counted by the sketch and sampled by the reservoir, so the memory doesn't
+// depend on the count of nodes
+class ColumnCollector {
+    static constexpr size_t kSampleSize = 4096;
+    static constexpr size_t kBuckets = 32;
+
+    size_t values_count_ = 0;
+    HyperLogLog sketch_;
+    std::vector<ColumnValue> sample_;
+    std::mt19937_64 random_;
+
+public:
+    void Add(ColumnValue value) {
+        sketch_.Add(value);
+        ++values_count_;
+        if (sample_.size() < kSampleSize) {
+            sample_.push_back(std::move(value));
+            return;
+        }
+        auto index = std::uniform_int_distribution<size_t>(0, values_count_ - 1)(random_);
+        if (index < kSampleSize) {
+            sample_[index] = std::move(value);
+        }
+    }
+
+    [[nodiscard]] ColumnStats Build(std::string name) {
+        std::sort(sample_.begin(), sample_.end());
+        std::vector<ColumnValue> bounds;
+        if (!sample_.empty()) {
+            auto buckets = std::min(kBuckets, sample_.size());
+            for (size_t i = 0; i < buckets; ++i) {
+                bounds.push_back(sample_[i * sample_.size() / buckets]);
+            }
+            bounds.push_back(sample_.back());
+        }
+        auto distinct = std::min(sketch_.Estimate(), static_cast<double>(values_count_));
+        return ColumnStats{std::move(name), values_count_, distinct, std::move(bounds)};
+    }
+};
+
+// Collects primitive and string fields of the nodes, nested fields are named by the path of
+// their classes. Relations also give degrees of their ends
+class Analyzer {
+    std::vector<std::string> names_;
+    std::unordered_map<std::string, ColumnCollector> columns_;
+    std::unordered_map<ts::ObjectId, size_t> out_degrees_;
+    std::unordered_map<ts::ObjectId, size_t> in_degrees_;
+
+    void AddValue(const std::string& name, ColumnValue value) {
+        auto [it, inserted] = columns_.try_emplace(name);
+        if (inserted) {
+            names_.push_back(name);
+        }
+        it->second.Add(std::move(value));
+    }
+
+    void AddObject(const ts::Object::Ptr& object, const std::string& name) {
+        auto path = [&name](const ts::Object::Ptr& field) {
+            return name.empty() ? field->GetClass()->Name()
+                                : name + "." + field->GetClass()->Name();
+        };
+
+        switch (object->GetClass()->GetKind()) {
+            case ts::kStructKind:
+                for (auto& field : std::static_pointer_cast<ts::Struct>(object)->GetFields()) {
+                    AddObject(field, path(field));
+                }
+                break;
+            case ts::kRelationKind: {
+                auto relation = std::static_pointer_cast<ts::Relation>(object);
+                ++out_degrees_[relation->FromId()];
+                ++in_degrees_[relation->ToId()];
+                if (relation->Attributes().has_value()) {
+                    AddObject(relation->Attributes().value(),
+                              path(relation->Attributes().value()));
+                }
+                break;
+            }
+            case ts::kStringKind:
+                AddValue(name, std::string(std::static_pointer_cast<ts::String>(object)->Value()));
+                break;
+            // Embeddings aren't compared by values, so they have no histograms
+            case ts::kVectorKind:
+                break;
+            default:
+                ts::VisitPrimitive(object->GetClass()->GetKind(), [&](auto type) {
+                    using P = typename decltype(type)::type;
+                    auto primitive = std::static_pointer_cast<ts::Primitive<P>>(object);
+                    AddValue(name, static_cast<double>(primitive->Value()));
+                });
+        }
+    }
+
+    void AddDegrees(const std::string& name,
+                    const std::unordered_map<ts::ObjectId, size_t>& degrees) {
+        for (auto& [id, degree] : degrees) {
+            AddValue(name, static_cast<double>(degree));
+        }
+    }
+
+public:
+    void Add(const ts::Object::Ptr& object) {
+        auto kind = object->GetClass()->GetKind();
+        AddObject(object, kind == ts::kStructKind || kind == ts::kRelationKind
+                              ? ""
+                              : object->GetClass()->Name());
+    }
+
+    [[nodiscard]] ClassAnalysis Build() {
+        AddDegrees("out_degree", out_degrees_);
+        AddDegrees("in_degree", in_degrees_);
+        std::vector<ColumnStats> columns;
+        for (auto& name : names_) {
+            columns.push_back(columns_.at(name).Build(name));
+        }
+        return ClassAnalysis(std::move(columns));
+    }
+};
+
+// Serialized analysis is kept in the chain of pages owned by the class
+class AnalysisStorage {
+    DECLARE_LOGGER;
+    mem::PageAllocator::Ptr alloc_;
+    mem::PageList page_list_;
+
+public:
+    AnalysisStorage(mem::PageAllocator::Ptr& alloc, mem::Offset sentinel_offset,
+                    DEFAULT_LOGGER(logger))
+        : LOGGER(logger),
+          alloc_(alloc),
+          page_list_("Statistics", alloc_->GetFile(), sentinel_offset, LOGGER) {
+    }
+
+    void Write(const ClassAnalysis& analysis) {
+        Drop();
+        auto& file = alloc_->GetFile();
+        auto buffer = analysis.Serialize();
+        auto capacity = alloc_->GetPageSize() - sizeof(mem::Page);
+        for (size_t written = 0; written < buffer.size(); written += capacity) {
+            auto chunk_size = std::min(capacity, buffer.size() - written);
+            page_list_.PushBack(alloc_->AllocatePage());
+            auto page = mem::ReadPage(mem::Page(page_list_.Back()), file);
+            page.type_ = mem::PageType::kStatistics;
+            page.free_offset_ = static_cast<mem::PageOffset>(sizeof(mem::Page) + chunk_size);
+            page.actual_size_ = chunk_size;
+            mem::WritePage(page, file);
+            file->Write(buffer, mem::GetOffset(page.index_, sizeof(mem::Page), file), written,
+                        chunk_size);
+        }
+        DEBUG("Statistics pages: ", page_list_.GetPagesCount());
+    }
+
+    [[nodiscard]] std::optional<ClassAnalysis> Read() {
+        if (page_list_.IsEmpty()) {
+            return std::nullopt;
+        }
+        auto& file = alloc_->GetFile();
+        std::vector<char> buffer;
+        for (auto& page : page_list_) {
+            auto chunk = file->ReadVector<char>(
+                mem::GetOffset(page.index_, sizeof(mem::Page), file), page.actual_size_);
+            buffer.insert(buffer.end(), chunk.begin(), chunk.end());
+        }
+        return ClassAnalysis::Deserialize(buffer);
+    }
+
+    void Drop() {
+        while (!page_list_.IsEmpty()) {
+            auto index = page_list_.Back();
+            page_list_.PopBack();
+            alloc_->FreePage(index);
+        }
+    }
+};
+
+}  // namespace db
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <bit>
+
+#include "free_space_map.hpp"
 #include "node.hpp"
 #include "node_storage.hpp"
+#include "node_view.hpp"
+#include "paged_array.hpp"
 #include "pagelist.hpp"
 
 namespace db {
@@ -16,7 +21,69 @@ namespace db {
  * Currently fixed but need to review it later cause I'm not sure that remade logic correct
  */
 
+// Follows the header of every page of fixed size nodes: the class magic is checked once per page.
+// Ids of compact nodes are derived from the page ordinal, that is never reused, and the slot
+struct ValPageHeader {
+    mem::Magic magic_;
+    size_t ordinal_;
+};
+
+// Validity bitmap of the slots follows the page header
+using BitmapWord = uint64_t;
+constexpr size_t kBitmapWordBits = 64;
+
+// Placement of records in the pages of the class, the end of ever used slots is kept in
+// initialized_offset_ of the page
+class ValPageLayout {
+public:
+    mem::NodeLayout layout_;
+    size_t record_size_;
+    size_t capacity_;
+    mem::PageOffset data_offset_;
+
+    ValPageLayout(mem::NodeLayout layout, size_t data_size, size_t page_size) : layout_(layout) {
+        record_size_ = layout_ == mem::NodeLayout::kCompact
+                           ? data_size
+                           : sizeof(mem::Magic) + sizeof(ts::ObjectId) + data_size;
+        auto available = page_size - sizeof(mem::Page) - sizeof(ValPageHeader);
+        capacity_ = available / record_size_;
+        while (capacity_ > 0 &&
+               BitmapWords() * sizeof(BitmapWord) + capacity_ * record_size_ > available) {
+            --capacity_;
+        }
+        data_offset_ = static_cast<mem::PageOffset>(sizeof(mem::Page) + sizeof(ValPageHeader) +
+                                                    BitmapWords() * sizeof(BitmapWord));
+    }
+
+    [[nodiscard]] bool IsCompact() const {
+        return layout_ == mem::NodeLayout::kCompact;
+    }
+
+    [[nodiscard]] size_t BitmapWords() const {
+        return (capacity_ + kBitmapWordBits - 1) / kBitmapWordBits;
+    }
+
+    [[nodiscard]] mem::PageOffset GetSlotOffset(size_t slot) const {
+        return static_cast<mem::PageOffset>(data_offset_ + slot * record_size_);
+    }
+
+    [[nodiscard]] size_t GetUsedSlots(const mem::Page& page) const {
+        return (page.initialized_offset_ - data_offset_) / record_size_;
+    }
+
+    [[nodiscard]] size_t GetValidSlots(const mem::Page& page) const {
+        return page.actual_size_ / record_size_;
+    }
+
+    [[nodiscard]] static mem::PageOffset GetBitmapOffset() {
+        return sizeof(mem::Page) + sizeof(ValPageHeader);
+    }
+};
+
 class ValNodeStorage : public NodeStorage {
+    ValPageLayout layout_;
+    mem::FreeSpaceMap free_space_map_;
+    mem::PagedArray<mem::PageIndex> page_table_;
 
 public:
     class NodeIterator {
@@ -25,95 +92,124 @@ public:
         ts::Class::Ptr node_class_;
         mem::File::Ptr file_;
         mem::PageList& page_list_;
+        ValPageLayout layout_;
 
-        mem::PageOffset inner_offset_;
+        size_t slot_;
         mem::PageList::PageIterator current_page_;
-
-        mem::Offset end_offset_;
+        PageBuffer page_;
 
         Node::Ptr curr_;
 
         [[nodiscard]] mem::PageOffset InPageOffset() const noexcept {
-            return inner_offset_;
+            return layout_.GetSlotOffset(slot_);
         }
         [[nodiscard]] mem::PageList::PageIterator Page() const noexcept {
             return current_page_;
         }
 
-        [[nodiscard]] size_t GetNodesInPage() const {
-            return (mem::kPageSize - sizeof(mem::Page)) / Size();
-        }
-
-        [[nodiscard]] ts::ObjectId GetInPageIndex() const {
-            return (inner_offset_ - sizeof(mem::Page)) / Size();
-        }
-
     public:
         [[nodiscard]] size_t Size() const {
-            return sizeof(mem::Magic) + sizeof(ts::ObjectId) + node_class_->Size().value();
+            return layout_.record_size_;
         }
 
         [[nodiscard]] ts::ObjectId Id() {
-            return file_->Read<ts::ObjectId>(GetRealOffset() +
-                                             static_cast<mem::Offset>(sizeof(mem::Magic)));
+            if (layout_.IsCompact()) {
+                return page_.Get<ValPageHeader>(sizeof(mem::Page)).ordinal_ * layout_.capacity_ +
+                       slot_;
+            }
+            return page_.Get<ts::ObjectId>(InPageOffset() + sizeof(mem::Magic));
+        }
+
+        // Reads the node from the copy of the page without building its object
+        [[nodiscard]] NodeView View() {
+            auto header_size = layout_.IsCompact() ? 0 : sizeof(mem::Magic) + sizeof(ts::ObjectId);
+            return NodeView(Id(), node_class_,
+                            page_.View(InPageOffset() + header_size,
+                                       layout_.record_size_ - header_size),
+                            page_);
         }
 
         [[nodiscard]] mem::Offset GetRealOffset() {
-            return mem::GetOffset(current_page_->index_, inner_offset_);
+            return mem::GetOffset(current_page_->index_, InPageOffset(), file_);
         }
 
     private:
-        void RegenerateEnd() {
-            auto back = mem::ReadPage(mem::Page(page_list_.Back()), file_);
-            end_offset_ = mem::GetOffset(back.index_, back.initialized_offset_);
+        [[nodiscard]] bool AtEnd() const {
+            return current_page_.Index() == mem::kSentinelIndex;
         }
 
-        ObjectState State() {
-            auto magic = file_->Read<mem::Magic>(GetRealOffset());
-            if (magic == magic_) {
-                return ObjectState::kValid;
-            } else if (magic == ~magic_) {
-                return ObjectState::kFree;
-            } else {
-                return ObjectState::kInvalid;
-                // throw error::RuntimeError("Invalid iterator");
+        // Page is read at once, then header, bitmap and records are taken from its copy
+        void LoadPage() {
+            if (AtEnd()) {
+                return;
+            }
+            page_.Load(file_, current_page_.Index());
+            if (page_.Get<ValPageHeader>(sizeof(mem::Page)).magic_ != magic_) {
+                throw error::StructureError("Page doesn't belong to the class");
             }
         }
 
-        void Advance() {
-            RegenerateEnd();
-            do {
-                if (GetRealOffset() >= end_offset_) {
-                    return;
+        [[nodiscard]] BitmapWord GetBitmapWord(size_t word) const {
+            return page_.Get<BitmapWord>(ValPageLayout::GetBitmapOffset() +
+                                         word * sizeof(BitmapWord));
+        }
+
+        [[nodiscard]] bool IsValid(size_t slot) const {
+            return GetBitmapWord(slot / kBitmapWordBits) >> (slot % kBitmapWordBits) & 1;
+        }
+
+        // Empty words are skipped at once, so sparse pages cost almost nothing
+        [[nodiscard]] size_t NextValid(size_t slot) const {
+            for (auto word = slot / kBitmapWordBits; word < layout_.BitmapWords(); ++word) {
+                auto bits = GetBitmapWord(word);
+                if (word == slot / kBitmapWordBits) {
+                    bits &= ~BitmapWord{0} << (slot % kBitmapWordBits);
                 }
-                if (GetInPageIndex() + 1 <= GetNodesInPage()) {
-                    inner_offset_ += Size();
-                } else {
-                    ++current_page_;
-                    inner_offset_ = sizeof(mem::Page);
+                if (bits != 0) {
+                    return word * kBitmapWordBits + std::countr_zero(bits);
                 }
-            } while (State() != ObjectState::kValid);
+            }
+            return layout_.capacity_;
         }
 
-        void Retreat() {
-            RegenerateEnd();
-            do {
-                if (page_list_.Front() == current_page_->index_ &&
-                    inner_offset_ == sizeof(mem::Page)) {
+        // Stays on the first valid slot starting from the current one
+        void SkipInvalid() {
+            while (!AtEnd()) {
+                slot_ = NextValid(slot_);
+                if (slot_ < layout_.capacity_) {
                     return;
                 }
-                if (GetInPageIndex() >= 1) {
-                    inner_offset_ -= Size();
-                } else {
+                ++current_page_;
+                slot_ = 0;
+                LoadPage();
+            }
+            slot_ = 0;
+        }
+
+        void Advance() {
+            ++slot_;
+            SkipInvalid();
+        }
+
+        void Retreat() {
+            do {
+                if (slot_ == 0) {
+                    if (!AtEnd() && page_list_.Front() == current_page_->index_) {
+                        return;
+                    }
                     --current_page_;
-                    inner_offset_ = static_cast<mem::PageOffset>(Size() * (GetNodesInPage() - 1) +
-                                                                 sizeof(mem::Page));
+                    LoadPage();
+                    slot_ = layout_.capacity_;
                 }
-            } while (State() != ObjectState::kValid);
+                --slot_;
+            } while (!IsValid(slot_));
         }
 
         void Read() {
-            curr_ = util::MakePtr<Node>(magic_, node_class_, file_, GetRealOffset());
+            auto view = View();
+            auto data = Node::NewObject(node_class_);
+            data->Read(view.Data().data());
+            curr_ = util::MakeArenaPtr<Node>(magic_, view.Id(), data);
         }
 
     public:
@@ -125,25 +221,16 @@ public:
         using reference = Node&;
 
         NodeIterator(mem::Magic magic, ts::Class::Ptr& node_class, mem::File::Ptr& file,
-                     mem::PageList& page_list, mem::PageList::PageIterator it,
-                     mem::PageOffset offset)
+                     mem::PageList& page_list, const ValPageLayout& layout, mem::PageIndex index)
             : magic_(magic),
               node_class_(node_class),
               file_(file),
               page_list_(page_list),
-              inner_offset_(offset),
-              current_page_(it) {
-            if (!page_list_.IsEmpty()) {
-                RegenerateEnd();
-                while (State() == ObjectState::kFree) {
-                    Advance();
-                }
-                if (GetRealOffset() != end_offset_) {
-                    Read();
-                }
-            } else {
-                current_page_ = page_list_.End();
-            }
+              layout_(layout),
+              slot_(0),
+              current_page_(page_list.IteratorTo(index)) {
+            LoadPage();
+            SkipInvalid();
         }
         NodeIterator& operator++() {
             Advance();
@@ -175,11 +262,7 @@ public:
         }
 
         bool operator==(const NodeIterator& other) const {
-            if (current_page_ == page_list_.End() && current_page_ == other.current_page_) {
-                return true;
-            } else {
-                return current_page_ == other.current_page_ && inner_offset_ == other.inner_offset_;
-            }
+            return current_page_ == other.current_page_ && slot_ == other.slot_;
         }
         bool operator!=(const NodeIterator& other) const {
             return !(*this == other);
@@ -189,96 +272,167 @@ public:
     template <ts::ClassLike C>
     ValNodeStorage(const util::Ptr<C>& nodes_class, ClassStorage::Ptr& class_storage,
                    mem::PageAllocator::Ptr& alloc, DEFAULT_LOGGER(logger))
-        : NodeStorage(nodes_class, class_storage, alloc, logger) {
+        : NodeStorage(nodes_class, class_storage, alloc, logger),
+          layout_(GetHeader().layout_, nodes_class->Size().value(), alloc->GetPageSize()),
+          free_space_map_("Free_Space_Map", alloc,
+                          GetHeader().GetFreeSpaceSentinelOffset(alloc->GetFile()),
+                          GetHeader().GetFreeSpaceDirectorySentinelOffset(alloc->GetFile()),
+                          logger),
+          page_table_("Page_Table", alloc, GetHeader().GetPageTableSentinelOffset(alloc->GetFile()),
+                      logger) {
         DEBUG("Val Node storage initialized with class: ", ts::ClassObject(nodes_class).ToString());
     }
 
     NodeIterator Begin() {
         return NodeIterator(GetHeader().magic_, nodes_class_, alloc_->GetFile(), data_page_list_,
-                            data_page_list_.Begin(), sizeof(mem::Page));
+                            layout_,
+                            data_page_list_.IsEmpty() ? mem::kSentinelIndex : GetFront().index_);
     }
 
     NodeIterator End() {
         return NodeIterator(GetHeader().magic_, nodes_class_, alloc_->GetFile(), data_page_list_,
-                            data_page_list_.IteratorTo(GetBack().index_),
-                            GetBack().initialized_offset_);
+                            layout_, mem::kSentinelIndex);
     }
 
 private:
-    template <ts::ObjectLike O>
-    ts::ObjectId WrtiteIntoFree(mem::Page& back, mem::ClassHeader& header, Node& next_free,
-                                util::Ptr<O>& node) {
-        DEBUG("Back in free ", back);
-        auto id = header.ReadNodeId(alloc_->GetFile()).id_;
-        DEBUG("Rewrited id: ", id);
-        DEBUG("Found free space: ", next_free.NextFree());
-        auto metaobject = Node(header.ReadMagic(alloc_->GetFile()).magic_, id, node);
-        metaobject.Write(alloc_->GetFile(), mem::GetOffset(back.index_, back.free_offset_));
-        back.free_offset_ = next_free.NextFree();
-        back.actual_size_ += metaobject.Size();
-        return metaobject.Id();
+    [[nodiscard]] ValPageHeader ReadPageHeader(mem::PageIndex index) {
+        return alloc_->GetFile()->Read<ValPageHeader>(
+            mem::GetOffset(index, sizeof(mem::Page), alloc_->GetFile()));
+    }
+
+    [[nodiscard]] size_t GetAvailableSpace(const mem::Page& page) const {
+        return (layout_.capacity_ - layout_.GetValidSlots(page)) * layout_.record_size_;
+    }
+
+    [[nodiscard]] bool IsOwnPage(const mem::Page& page) {
+        return page.type_ == mem::PageType::kData &&
+               page.owner_ == GetHeader().GetNodeListSentinelOffset(alloc_->GetFile());
+    }
+
+    // Only compact pages get ordinals
+    mem::Page AllocateValPage() {
+        auto& file = alloc_->GetFile();
+        auto page = AllocatePage();
+        auto header = ValPageHeader{GetHeader().magic_, 0};
+        if (layout_.IsCompact()) {
+            header.ordinal_ = page_table_.PushBack(page.index_);
+            DEBUG("Compact page ordinal: ", header.ordinal_);
+        }
+
+        auto header_offset = mem::GetOffset(page.index_, sizeof(mem::Page), file);
+        file->Write<ValPageHeader>(header, header_offset);
+        file->Write(std::vector<BitmapWord>(layout_.BitmapWords(), 0),
+                    header_offset + static_cast<mem::Offset>(sizeof(ValPageHeader)));
+        page.initialized_offset_ = layout_.data_offset_;
+        page.free_offset_ = layout_.data_offset_;
+        return mem::WritePage(page, file);
+    }
+
+    [[nodiscard]] mem::Offset GetBitmapWordOffset(const mem::Page& page, size_t slot) {
+        return mem::GetOffset(
+            page.index_,
+            static_cast<mem::PageOffset>(ValPageLayout::GetBitmapOffset() +
+                                         slot / kBitmapWordBits * sizeof(BitmapWord)),
+            alloc_->GetFile());
+    }
+
+    void WriteValidity(const mem::Page& page, size_t slot, bool valid) {
+        auto& file = alloc_->GetFile();
+        auto offset = GetBitmapWordOffset(page, slot);
+        auto word = file->Read<BitmapWord>(offset);
+        auto bit = BitmapWord{1} << (slot % kBitmapWordBits);
+        file->Write<BitmapWord>(valid ? word | bit : word & ~bit, offset);
+    }
+
+    // The first free slot is found by the bitmap, freed records are never read
+    [[nodiscard]] size_t FindFreeSlot(const mem::Page& page) {
+        if (layout_.IsCompact()) {
+            return layout_.GetUsedSlots(page);
+        }
+        auto bitmap = alloc_->GetFile()->ReadVector<BitmapWord>(GetBitmapWordOffset(page, 0),
+                                                                layout_.BitmapWords());
+        for (size_t word = 0; word < bitmap.size(); ++word) {
+            if (~bitmap[word] != 0) {
+                return word * kBitmapWordBits + std::countr_one(bitmap[word]);
+            }
+        }
+        return layout_.capacity_;
+    }
+
+    // Freed slots of compact pages are not reused, so derived ids are never given twice
+    [[nodiscard]] bool HasFreeSlot(const mem::Page& page) const {
+        return (layout_.IsCompact() ? layout_.GetUsedSlots(page) : layout_.GetValidSlots(page)) <
+               layout_.capacity_;
+    }
+
+    // The back page is tried first, then the free space map is asked for any page with a free
+    // slot, its stale entries are fixed on the way
+    mem::Page GetPageFor() {
+        if (!data_page_list_.IsEmpty()) {
+            auto back = GetBack();
+            if (HasFreeSlot(back)) {
+                return back;
+            }
+        }
+        if (!layout_.IsCompact()) {
+            while (auto index = free_space_map_.Find(layout_.record_size_)) {
+                auto page = mem::ReadPage(mem::Page(index.value()), alloc_->GetFile());
+                if (IsOwnPage(page) && HasFreeSlot(page)) {
+                    DEBUG("Reusing page ", page);
+                    return page;
+                }
+                free_space_map_.Update(index.value(),
+                                       IsOwnPage(page) ? GetAvailableSpace(page) : 0);
+            }
+        }
+        DEBUG("Allocation");
+        return AllocateValPage();
     }
 
     template <ts::ObjectLike O>
-    ts::ObjectId WriteIntoInvalid(mem::Page& back, mem::ClassHeader& header, util::Ptr<O>& node) {
-        DEBUG("Back in invalid ", back);
-        auto id = header.ReadNodeId(alloc_->GetFile()).id_;
-        auto metaobject = Node(header.ReadMagic(alloc_->GetFile()).magic_, id, node);
-        if (back.initialized_offset_ + metaobject.Size() >= mem::kPageSize) {
-            DEBUG("Allocation");
-            AllocatePage();
-            back = GetBack();
-        }
-        DEBUG("Initializing new memory on id: ", id,
-              ", offset: ", mem::GetOffset(back.index_, back.initialized_offset_));
-
-        metaobject.Write(alloc_->GetFile(), mem::GetOffset(back.index_, back.free_offset_));
-        back.free_offset_ += metaobject.Size();
-        back.initialized_offset_ += metaobject.Size();
-        back.actual_size_ += metaobject.Size();
-        return metaobject.Id();
+    ts::ObjectId WriteNode(util::Ptr<O>& node) {
+        auto& file = alloc_->GetFile();
+        auto header = GetHeader();
+        auto page = GetPageFor();
+        auto slot = FindFreeSlot(page);
+        auto offset = mem::GetOffset(page.index_, layout_.GetSlotOffset(slot), file);
+
+        ts::ObjectId id;
+        if (layout_.IsCompact()) {
+            id = ReadPageHeader(page.index_).ordinal_ * layout_.capacity_ + slot;
+            node->Write(file, offset);
+        } else {
+            id = class_storage_->NewNodeId(header);
+            Node(header.magic_, id, node).Write(file, offset);
+            SetLocation(id, NodeLocation{page.index_, slot});
+        }
+        DEBUG("Initializing new memory on id: ", id, ", offset: ", offset);
+        WriteValidity(page, slot, true);
+
+        page.initialized_offset_ = std::max(page.initialized_offset_,
+                                            layout_.GetSlotOffset(slot + 1));
+        page.free_offset_ = page.initialized_offset_;
+        page.actual_size_ += layout_.record_size_;
+        mem::WritePage(page, file);
+        if (!layout_.IsCompact()) {
+            free_space_map_.Update(page.index_, GetAvailableSpace(page));
+        }
+        CountInsertion(header, id, layout_.record_size_);
+        IndexNode(header, id, node);
+        return id;
     }
 
 public:
     template <ts::ObjectLike O>
     requires(!std::is_same_v<O, ts::ClassObject>) void AddNode(util::Ptr<O>& node) {
 
-        if (node->Size() + sizeof(mem::Magic) + sizeof(ts::ObjectId) + sizeof(mem::Page) >=
-            mem::kPageSize) {
+        if (layout_.capacity_ == 0) {
             throw error::NotImplemented("Too big Object");
         }
 
         INFO("Addding node: ", node->ToString());
-        auto header = GetHeader();
-        auto back = GetBack();
-        auto next_free = Node(header.ReadMagic(alloc_->GetFile()).magic_, nodes_class_,
-                              alloc_->GetFile(), mem::GetOffset(back.index_, back.free_offset_));
-        DEBUG("Free: ", next_free.ToString());
-
-        ts::ObjectId id;
-        switch (next_free.State()) {
-            case ObjectState::kFree: {
-                // if (back.initialized_offset_ == back.free_offset_) {
-                //     id = WriteIntoInvalid(back, header, node);
-                // } else {
-                // BUG: Need to generate magics for class;
-                id = WrtiteIntoFree(back, header, next_free, node);
-                // }
-            } break;
-            case ObjectState::kInvalid: {
-                id = WriteIntoInvalid(back, header, node);
-            } break;
-            case ObjectState::kValid:
-                throw error::RuntimeError("Already occupied memory");
-            default:
-                break;
-        }
+        auto id = WriteNode(node);
         INFO("Successfully added node with id: ", id);
-
-        mem::WritePage(back, alloc_->GetFile());
-        DEBUG("Back ", back);
-        header.WriteNodeId(alloc_->GetFile(), ++header.ReadNodeId(alloc_->GetFile()).id_);
-        DEBUG("Id: ", GetHeader().id_);
     }
 
     template <typename Predicate, typename Functor>
@@ -291,7 +445,7 @@ public:
         auto end = End();
         for (auto node_it = Begin(); node_it != end; ++node_it) {
             if (predicate(node_it)) {
-                DEBUG("Node: ", node_it->ToString());
+                DEBUG("Node: ", node_it.Id());
                 functor(node_it);
             }
         }
@@ -303,36 +457,111 @@ public:
         DEBUG("Removing nodes..");
 
         auto end = End();
-        // size_t count = 0;
         std::vector<mem::PageIndex> free_pages;
+        RemovalStats removal;
+        auto vector_index = GetVectorIndex();
+        auto quantized_index = GetQuantizedIndex();
+        std::vector<ts::ObjectId> removed_ids;
         for (auto node_it = Begin(); node_it != end; ++node_it) {
-            if (predicate(node_it)) {
+            if (!predicate(node_it)) {
+                removal.Kept(node_it.Id());
+            } else {
                 DEBUG("Removing node ", node_it.Id());
+                removal.Removed(layout_.record_size_);
+                if (vector_index.IsBuilt()) {
+                    vector_index.Remove(node_it.Id());
+                }
+                if (quantized_index.IsBuilt()) {
+                    removed_ids.push_back(node_it.Id());
+                }
+                if (!layout_.IsCompact()) {
+                    RemoveLocation(node_it.Id());
+                }
                 auto page = mem::ReadPage(*node_it.Page(), alloc_->GetFile());
-                auto node = *node_it;
-
-                page.actual_size_ -= node.Size();
-                node.Free(page.free_offset_);
-                node.Write(alloc_->GetFile(),
-                           mem::GetOffset(node_it.Page()->index_, node_it.InPageOffset()));
-                DEBUG("Node: ", node.ToString());
-                page.free_offset_ = node_it.InPageOffset();
+                WriteValidity(page, node_it.slot_, false);
+                page.actual_size_ -= layout_.record_size_;
                 DEBUG("Page: ", page);
                 mem::WritePage(page, alloc_->GetFile());
 
                 if (page.actual_size_ == 0) {
                     INFO("Deallocated page", page);
                     free_pages.push_back(page.index_);
+                } else if (!layout_.IsCompact()) {
+                    free_space_map_.Update(page.index_, GetAvailableSpace(page));
                 }
-                // ++count;
             }
         }
         for (auto id : free_pages) {
+            if (layout_.IsCompact()) {
+                page_table_.Set(ReadPageHeader(id).ordinal_, mem::kSentinelIndex);
+            }
+            free_space_map_.Update(id, 0);
             FreePage(id);
         }
-        // TODO: see above
-        // auto header = GetHeader();
-        // header.WriteNodeCount(alloc_->GetFile(), header.nodes_ - count);
+        // Map of the class without pages is empty, so its pages are freed as well
+        if (data_page_list_.IsEmpty()) {
+            free_space_map_.Drop();
+        }
+        if (!removed_ids.empty()) {
+            quantized_index.Remove(removed_ids);
+        }
+        TrimLocations();
+        CountRemoval(removal);
+    }
+
+    // Resolves the node by its id without scanning, ids of compact nodes are resolved by the page
+    // table and the others by the id table
+    [[nodiscard]] std::optional<Node> FindNode(ts::ObjectId id) {
+        auto& file = alloc_->GetFile();
+        auto magic = GetHeader().magic_;
+        if (layout_.IsCompact()) {
+            auto ordinal = id / layout_.capacity_;
+            if (ordinal >= page_table_.Size() || page_table_.Get(ordinal) == mem::kSentinelIndex) {
+                return std::nullopt;
+            }
+            auto page = mem::Page(page_table_.Get(ordinal));
+            auto slot = id % layout_.capacity_;
+            auto word = file->Read<BitmapWord>(GetBitmapWordOffset(page, slot));
+            if ((word >> (slot % kBitmapWordBits) & 1) == 0) {
+                return std::nullopt;
+            }
+            auto data = Node::NewObject(nodes_class_);
+            data->Read(file, mem::GetOffset(page.index_, layout_.GetSlotOffset(slot), file));
+            return Node(magic, id, data);
+        }
+
+        auto location = GetLocation(id);
+        if (!location.has_value()) {
+            return std::nullopt;
+        }
+        return Node(magic, nodes_class_, file,
+                    mem::GetOffset(location->index_, layout_.GetSlotOffset(location->slot_),
+                                   file));
+    }
+
+    // Page indices change after the compaction of the file, ordinals and slots are kept
+    void RebuildIndices() {
+        free_space_map_.Clear();
+        for (auto& page : data_page_list_) {
+            if (layout_.IsCompact()) {
+                page_table_.Set(ReadPageHeader(page.index_).ordinal_, page.index_);
+            } else {
+                free_space_map_.Update(page.index_, GetAvailableSpace(page));
+            }
+        }
+        if (!layout_.IsCompact()) {
+            auto end = End();
+            for (auto node_it = Begin(); node_it != end; ++node_it) {
+                SetLocation(node_it.Id(),
+                            NodeLocation{node_it.current_page_->index_, node_it.slot_});
+            }
+        }
+    }
+
+    void Drop() {
+        page_table_.Drop();
+        free_space_map_.Drop();
+        NodeStorage::Drop();
     }
 };
-}  // namespace db
\ No newline at end of file
+}  // namespace db
@@ -1,12 +1,23 @@
 #pragma once
 
+#include <string_view>
+
+#include "free_space_map.hpp"
 #include "node.hpp"
 #include "node_storage.hpp"
+#include "node_view.hpp"
 
 namespace db {
 
+// Pages are slotted: records grow from the page header, the slot directory grows from the end of
+// the page, so records could be moved inside the page without changing their slots
 class VarNodeStorage : public NodeStorage {
 
+    // Values with records bigger than this part of a page are moved to the overflow pages
+    static constexpr size_t kOverflowFraction = 4;
+
+    mem::FreeSpaceMap free_space_map_;
+
 public:
     class NodeIterator {
     private:
@@ -15,72 +26,145 @@ public:
         mem::File::Ptr file_;
         mem::PageList& page_list_;
 
-        mem::PageOffset inner_offset_;
+        mem::PageOffset slot_;
+        mem::PageOffset slots_count_;
         mem::PageList::PageIterator current_page_;
-
-        mem::Offset end_offset_;
+        PageBuffer page_;
+        // Overflowed value is gathered here when it's viewed
+        std::string overflow_data_;
 
         Node::Ptr curr_;
 
+        [[nodiscard]] mem::Slot GetSlot() const {
+            return page_.Get<mem::Slot>(file_->GetPageSize() - (slot_ + 1) * sizeof(mem::Slot));
+        }
+
     public:
         [[nodiscard]] ts::ObjectId Id() {
-            return file_->Read<ts::ObjectId>(GetRealOffset() +
-                                             static_cast<mem::Offset>(sizeof(mem::Magic)));
+            return page_.Get<ts::ObjectId>(GetSlot().offset_ + sizeof(mem::Magic));
         }
         [[nodiscard]] mem::Offset GetRealOffset() {
-            return mem::GetOffset(current_page_->index_, inner_offset_);
+            return mem::GetOffset(current_page_.Index(), GetSlot().offset_, file_);
+        }
+        [[nodiscard]] bool IsOverflowed() {
+            return page_.Get<mem::Magic>(GetSlot().offset_) == OverflowMagic(magic_);
+        }
+
+        // Reads the node from the copy of the page without building its object, only overflowed
+        // values are copied
+        [[nodiscard]] NodeView View() {
+            if (!IsOverflowed()) {
+                auto record = GetSlot();
+                return NodeView(Id(), node_class_,
+                                page_.View(record.offset_ + Node::kHeaderSize,
+                                           record.size_ - Node::kHeaderSize),
+                                page_);
+            }
+            overflow_data_.clear();
+            StreamData([this](std::string_view chunk) { overflow_data_.append(chunk); });
+            return NodeView(Id(), node_class_, overflow_data_, page_);
+        }
+
+        // Passes the serialized value to the functor chunk by chunk, only the requested range is
+        // read from the file, so big values are never materialized
+        template <typename Functor>
+        requires std::is_invocable_v<Functor, std::string_view>
+        void StreamData(Functor functor, size_t from = 0,
+                        size_t count = std::string_view::npos) {
+            auto data_offset = GetRealOffset() + static_cast<mem::Offset>(sizeof(mem::Magic) +
+                                                                          sizeof(ts::ObjectId));
+            if (!IsOverflowed()) {
+                auto size = GetSlot().size_ - sizeof(mem::Magic) - sizeof(ts::ObjectId);
+                if (from >= size || count == 0) {
+                    return;
+                }
+                auto chunk = file_->ReadString(data_offset + static_cast<mem::Offset>(from),
+                                               std::min(count, size - from));
+                functor(std::string_view(chunk));
+                return;
+            }
+
+            auto overflow = file_->Read<Overflow>(data_offset);
+            if (from >= overflow.size_ || count == 0) {
+                return;
+            }
+            auto end = from + std::min(count, overflow.size_ - from);
+            size_t position = 0;
+            auto index = overflow.sentinel_.previous_page_index_;
+            while (index != mem::kSentinelIndex && position < end) {
+                auto page = mem::ReadPage(mem::Page(index), file_);
+                size_t chunk_size = page.free_offset_ - sizeof(mem::Page);
+                if (position + chunk_size > from) {
+                    auto begin = std::max(from, position);
+                    auto last = std::min(end, position + chunk_size);
+                    auto chunk = file_->ReadString(
+                        mem::GetOffset(index,
+                                       static_cast<mem::PageOffset>(sizeof(mem::Page) + begin -
+                                                                    position),
+                                       file_),
+                        last - begin);
+                    functor(std::string_view(chunk));
+                }
+                position += chunk_size;
+                index = page.previous_page_index_;
+            }
+        }
+
+        // Reads at most count first characters of the string value
+        [[nodiscard]] std::string ReadStringPrefix(size_t count) {
+            if (node_class_->GetKind() != ts::kStringKind) {
+                throw error::TypeError("Prefix can be read only from the string");
+            }
+            std::string prefix;
+            StreamData([&prefix](std::string_view chunk) { prefix.append(chunk); },
+                       sizeof(ts::String::SizeType), count);
+            return prefix;
         }
 
     private:
-        [[nodiscard]] mem::PageOffset InPageOffset() const noexcept {
-            return inner_offset_;
+        [[nodiscard]] mem::PageOffset SlotIndex() const noexcept {
+            return slot_;
         }
         [[nodiscard]] mem::PageList::PageIterator Page() const noexcept {
             return current_page_;
         }
 
-        void RegenerateEnd() {
-            auto back = mem::ReadPage(mem::Page(page_list_.Back()), file_);
-            end_offset_ = mem::GetOffset(back.index_, back.free_offset_);
+        void LoadSlots() {
+            slots_count_ = 0;
+            if (current_page_.Index() != mem::kSentinelIndex) {
+                page_.Load(file_, current_page_.Index());
+                slots_count_ = page_.Get<mem::Page>(0).slots_count_;
+            }
         }
 
-        ObjectState State() {
-            auto magic = file_->Read<mem::Magic>(GetRealOffset());
-            if (magic == magic_) {
-                return ObjectState::kValid;
-            } else if (magic == ~magic_) {
-                return ObjectState::kFree;
-            } else {
-                return ObjectState::kInvalid;
-                // throw error::RuntimeError("Invalid iterator");
+        // Page is read at once, so empty slots are skipped without touching the file and nodes
+        // are built only on access
+        void SkipEmpty() {
+            curr_ = nullptr;
+            while (current_page_.Index() != mem::kSentinelIndex) {
+                for (; slot_ < slots_count_; ++slot_) {
+                    if (GetSlot().offset_ != mem::kEmptySlot) {
+                        return;
+                    }
+                }
+                ++current_page_;
+                slot_ = 0;
+                LoadSlots();
             }
         }
 
-        void Read() {
-            curr_ = util::MakePtr<Node>(magic_, node_class_, file_, GetRealOffset());
+        Node::Ptr& Load() {
+            if (!curr_) {
+                auto record = GetSlot();
+                curr_ = util::MakeArenaPtr<Node>(magic_, node_class_, file_,
+                                                 page_.View(record.offset_, record.size_));
+            }
+            return curr_;
         }
 
         void Advance() {
-            if (State() == ObjectState::kValid) {
-                inner_offset_ += curr_->Size();
-            }
-            while (State() != ObjectState::kValid) {
-                if (GetRealOffset() >= end_offset_) {
-                    return;
-                }
-                auto offset = file_->Read<mem::PageOffset>(
-                    GetRealOffset() + static_cast<mem::PageOffset>(sizeof(mem::Magic)));
-                // offset == 0
-                if (State() == ObjectState::kInvalid) {
-                    ++current_page_;
-                    inner_offset_ = current_page_->initialized_offset_;
-                } else {
-                    inner_offset_ = offset;
-                }
-            }
-            if (State() == ObjectState::kValid) {
-                Read();
-            }
+            ++slot_;
+            SkipEmpty();
         }
 
     public:
@@ -92,24 +176,15 @@ public:
         using reference = Node&;
 
         NodeIterator(mem::Magic magic, ts::Class::Ptr& node_class, mem::File::Ptr& file,
-                     mem::PageList& page_list, mem::PageIndex index, mem::PageOffset inner_offset)
+                     mem::PageList& page_list, mem::PageIndex index, mem::PageOffset slot)
             : magic_(magic),
               node_class_(node_class),
               file_(file),
               page_list_(page_list),
-              inner_offset_(inner_offset),
+              slot_(slot),
               current_page_(page_list.IteratorTo(index)) {
-
-            if (!page_list_.IsEmpty()) {
-                RegenerateEnd();
-                Read();
-                while (State() == ObjectState::kFree) {
-                    Advance();
-                }
-
-            } else {
-                current_page_ = page_list_.End();
-            }
+            LoadSlots();
+            SkipEmpty();
         }
 
         NodeIterator& operator++() {
@@ -123,18 +198,14 @@ public:
         }
 
         reference operator*() {
-            return *curr_;
+            return *Load();
         }
         pointer operator->() {
-            return curr_;
+            return Load();
         }
 
         bool operator==(const NodeIterator& other) const {
-            if (current_page_ == page_list_.End() && current_page_ == other.current_page_) {
-                return true;
-            } else {
-                return current_page_ == other.current_page_ && inner_offset_ == other.inner_offset_;
-            }
+            return current_page_ == other.current_page_ && slot_ == other.slot_;
         }
         bool operator!=(const NodeIterator& other) const {
             return !(*this == other);
@@ -144,59 +215,232 @@ public:
     template <ts::ClassLike C>
     VarNodeStorage(const util::Ptr<C>& nodes_class, util::Ptr<ClassStorage>& class_storage,
                    mem::PageAllocator::Ptr& alloc, DEFAULT_LOGGER(logger))
-        : NodeStorage(nodes_class, class_storage, alloc, logger) {
+        : NodeStorage(nodes_class, class_storage, alloc, logger),
+          free_space_map_("Free_Space_Map", alloc,
+                          GetHeader().GetFreeSpaceSentinelOffset(alloc->GetFile()),
+                          GetHeader().GetFreeSpaceDirectorySentinelOffset(alloc->GetFile()),
+                          logger) {
         DEBUG("Var Node storage initialized with class: ", ts::ClassObject(nodes_class).ToString());
     }
 
     NodeIterator Begin() {
         return NodeIterator(GetHeader().magic_, nodes_class_, alloc_->GetFile(), data_page_list_,
-                            GetFront().index_, GetFront().initialized_offset_);
+                            data_page_list_.IsEmpty() ? mem::kSentinelIndex : GetFront().index_,
+                            0);
     }
 
     NodeIterator End() {
         return NodeIterator(GetHeader().magic_, nodes_class_, alloc_->GetFile(), data_page_list_,
-                            GetBack().index_, GetBack().free_offset_);
+                            mem::kSentinelIndex, 0);
     }
 
 private:
-    mem::Offset GetNewNodeOffset(size_t node_size) {
+    // Contiguous space between the data and the slot directory
+    [[nodiscard]] size_t GetFreeSpace(const mem::Page& page) const {
+        return alloc_->GetPageSize() - page.slots_count_ * sizeof(mem::Slot) - page.free_offset_;
+    }
+
+    // Space that the page would have after the compaction
+    [[nodiscard]] size_t GetReclaimableSpace(const mem::Page& page) const {
+        return alloc_->GetPageSize() - page.slots_count_ * sizeof(mem::Slot) - sizeof(mem::Page) -
+               page.actual_size_;
+    }
+
+    // Size of the biggest record that fits into the page
+    [[nodiscard]] size_t GetAvailableSpace(const mem::Page& page) const {
+        auto slot_size = page.free_slot_ < page.slots_count_ ? 0 : sizeof(mem::Slot);
+        return std::max(GetReclaimableSpace(page), slot_size) - slot_size;
+    }
+
+    [[nodiscard]] bool Fits(const mem::Page& page, size_t record_size) const {
+        return GetAvailableSpace(page) >= record_size;
+    }
+
+    [[nodiscard]] bool IsOwnPage(const mem::Page& page) {
+        return page.type_ == mem::PageType::kData &&
+               page.owner_ == GetHeader().GetNodeListSentinelOffset(alloc_->GetFile());
+    }
+
+    void RetagOverflow(mem::Offset record_offset) {
+        auto& file = alloc_->GetFile();
+        auto sentinel_offset = Node::GetOverflowSentinelOffset(record_offset);
+        auto overflow = mem::PageList("Overflow", file, sentinel_offset, LOGGER);
+        for (auto& page : overflow) {
+            page.owner_ = sentinel_offset;
+            mem::WritePage(page, file);
+        }
+    }
+
+    // Moves live records to the beginning of the page, their slots are kept
+    void CompactPage(mem::Page& page) {
+        DEBUG("Compacting page: ", page);
+        auto& file = alloc_->GetFile();
+        auto magic = GetHeader().magic_;
+        auto slots = mem::ReadSlots(page, file);
+        auto data = file->ReadVector<char>(mem::GetOffset(page.index_, sizeof(mem::Page), file),
+                                           page.free_offset_ - sizeof(mem::Page));
+
+        std::vector<mem::PageOffset> order;
+        for (mem::PageOffset slot = 0; slot < slots.size(); ++slot) {
+            if (slots[slot].offset_ != mem::kEmptySlot) {
+                order.push_back(slot);
+            }
+        }
+        std::sort(order.begin(), order.end(), [&slots](auto lhs, auto rhs) {
+            return slots[lhs].offset_ < slots[rhs].offset_;
+        });
+
+        std::vector<char> compacted;
+        compacted.reserve(page.actual_size_);
+        std::vector<mem::Offset> overflowed;
+        for (auto slot : order) {
+            auto begin = data.begin() + (slots[slot].offset_ - sizeof(mem::Page));
+            mem::Magic record_magic;
+            std::memcpy(&record_magic, &*begin, sizeof(mem::Magic));
+            slots[slot].offset_ =
+                static_cast<mem::SlotOffset>(sizeof(mem::Page) + compacted.size());
+            if (record_magic == OverflowMagic(magic)) {
+                overflowed.push_back(mem::GetOffset(page.index_, slots[slot].offset_, file));
+            }
+            compacted.insert(compacted.end(), begin, begin + slots[slot].size_);
+        }
+
+        if (!compacted.empty()) {
+            file->Write(compacted, mem::GetOffset(page.index_, sizeof(mem::Page), file));
+        }
+        mem::WriteSlots(page, slots, file);
+        page.free_offset_ = static_cast<mem::PageOffset>(sizeof(mem::Page) + compacted.size());
+        mem::WritePage(page, file);
+        for (auto offset : overflowed) {
+            RetagOverflow(offset);
+        }
+    }
+
+    // Reserves the slot and the space for the record in the page that must fit it
+    mem::Offset PlaceRecord(mem::Page& page, size_t record_size) {
+        auto& file = alloc_->GetFile();
+        auto slot_size = page.free_slot_ < page.slots_count_ ? 0 : sizeof(mem::Slot);
+        if (GetFreeSpace(page) < record_size + slot_size) {
+            CompactPage(page);
+        }
+
+        auto record = mem::Slot{static_cast<mem::SlotOffset>(page.free_offset_),
+                                static_cast<mem::SlotOffset>(record_size)};
+        page.free_offset_ += record.size_;
+        page.actual_size_ += record.size_;
+
+        auto slot = page.free_slot_;
+        if (slot == page.slots_count_) {
+            ++page.slots_count_;
+        }
+        mem::WriteSlot(page, slot, record, file);
+
+        page.free_slot_ = slot + 1;
+        while (page.free_slot_ < page.slots_count_ &&
+               mem::ReadSlot(page, page.free_slot_, file).offset_ != mem::kEmptySlot) {
+            ++page.free_slot_;
+        }
+        mem::WritePage(page, file);
+        free_space_map_.Update(page.index_, GetAvailableSpace(page));
+        DEBUG("Slot ", slot, " in page ", page);
+        return mem::GetOffset(page.index_, record.offset_, file);
+    }
+
+    void RemoveRecord(mem::Page& page, mem::PageOffset slot) {
+        auto& file = alloc_->GetFile();
+        auto record = mem::ReadSlot(page, slot, file);
+        page.actual_size_ -= record.size_;
+        mem::WriteSlot(page, slot, mem::Slot{mem::kEmptySlot, 0}, file);
+        page.free_slot_ = std::min(page.free_slot_, slot);
+
+        // Trailing empty slots are given back to the data
+        while (page.slots_count_ > 0 &&
+               mem::ReadSlot(page, page.slots_count_ - 1, file).offset_ == mem::kEmptySlot) {
+            --page.slots_count_;
+        }
+        page.free_slot_ = std::min(page.free_slot_, page.slots_count_);
+        if (page.slots_count_ == 0) {
+            page.free_offset_ = sizeof(mem::Page);
+        }
+        mem::WritePage(page, file);
+        free_space_map_.Update(page.index_, GetAvailableSpace(page));
+    }
+
+    // The back page is tried first, then the free space map is asked for any page with enough
+    // room, its stale entries are fixed on the way
+    mem::Page GetPageFor(size_t record_size) {
         auto back = GetBack();
-        if (back.free_offset_ + node_size >= mem::kPageSize) {
-            DEBUG("Allocation");
-            // Maybe should think about the case | valid | new | -> | free | new |
+        if (Fits(back, record_size)) {
+            return back;
+        }
+        while (auto index = free_space_map_.Find(record_size + sizeof(mem::Slot))) {
+            auto page = mem::ReadPage(mem::Page(index.value()), alloc_->GetFile());
+            if (IsOwnPage(page) && Fits(page, record_size)) {
+                DEBUG("Reusing page ", page);
+                return page;
+            }
+            free_space_map_.Update(index.value(), IsOwnPage(page) ? GetAvailableSpace(page) : 0);
+        }
+        DEBUG("Allocation");
+        return AllocatePage();
+    }
+
+    void WriteOverflow(const ts::Object::Ptr& node, mem::Offset record_offset) {
+        auto& file = alloc_->GetFile();
+        std::vector<char> buffer(node->Size());
+        node->Write(buffer.data());
+
+        auto overflow =
+            mem::PageList("Overflow", file, Node::GetOverflowSentinelOffset(record_offset), LOGGER);
+        auto capacity = alloc_->GetPageSize() - sizeof(mem::Page);
+        for (size_t written = 0; written < buffer.size(); written += capacity) {
+            auto chunk_size = std::min(capacity, buffer.size() - written);
+            overflow.PushBack(alloc_->AllocatePage());
+            auto page = mem::ReadPage(mem::Page(overflow.Back()), file);
+            page.type_ = mem::PageType::kOverflow;
+            page.free_offset_ = static_cast<mem::PageOffset>(sizeof(mem::Page) + chunk_size);
+            page.actual_size_ = chunk_size;
+            mem::WritePage(page, file);
+            file->Write(buffer, mem::GetOffset(page.index_, sizeof(mem::Page), file), written,
+                        chunk_size);
+        }
+        DEBUG("Overflow pages: ", overflow.GetPagesCount());
+    }
 
-            AllocatePage();
-            back = GetBack();
+    void FreeOverflow(mem::Offset record_offset) {
+        auto overflow = mem::PageList("Overflow", alloc_->GetFile(),
+                                      Node::GetOverflowSentinelOffset(record_offset), LOGGER);
+        while (!overflow.IsEmpty()) {
+            auto index = overflow.Back();
+            overflow.PopBack();
+            alloc_->FreePage(index);
         }
-        return mem::GetOffset(back.index_, back.free_offset_);
     }
 
 public:
     template <ts::ObjectLike O>
     requires(!std::is_same_v<O, ts::ClassObject>) void AddNode(util::Ptr<O>& node) {
-
-        if (node->Size() + sizeof(mem::Magic) + sizeof(ts::ObjectId) + sizeof(mem::Page) >=
-            mem::kPageSize) {
-            throw error::NotImplemented("Too big Object");
-        }
-
         INFO("Addding node: ", node->ToString());
-        auto id = GetHeader().ReadNodeId(alloc_->GetFile()).id_;
-        auto metaobject = Node(GetHeader().ReadMagic(alloc_->GetFile()).magic_, id, node);
-        auto node_offset = GetNewNodeOffset(metaobject.Size());
-        auto back = GetBack();
+        auto header = GetHeader();
+        auto id = class_storage_->NewNodeId(header);
+        auto metaobject = Node(header.magic_, id, node);
+        if (metaobject.Size() > alloc_->GetPageSize() / kOverflowFraction) {
+            metaobject.MoveToOverflow();
+        }
+        auto page = GetPageFor(metaobject.Size());
+        auto slot = page.free_slot_;
+        auto node_offset = PlaceRecord(page, metaobject.Size());
+        SetLocation(id, NodeLocation{page.index_, slot});
         DEBUG("Initializing new memory on id: ", id, ", offset: ", node_offset);
 
         metaobject.Write(alloc_->GetFile(), node_offset);
-        back.free_offset_ += metaobject.Size();
-        back.actual_size_ += metaobject.Size();
+        if (metaobject.IsOverflowed()) {
+            WriteOverflow(node, node_offset);
+        }
+        CountInsertion(header, id, metaobject.Size());
+        IndexNode(header, id, node);
 
         INFO("Successfully added node with id: ", id);
-
-        mem::WritePage(back, alloc_->GetFile());
-        DEBUG("Back ", back);
-        GetHeader().WriteNodeId(alloc_->GetFile(), ++id);
-        DEBUG("Count ", GetHeader().id_);
     }
 
     template <typename Predicate, typename Functor>
@@ -209,7 +453,7 @@ public:
         auto end = End();
         for (auto node_it = Begin(); node_it != end; ++node_it) {
             if (predicate(node_it)) {
-                DEBUG("Node: ", node_it->ToString());
+                DEBUG("Node: ", node_it.Id());
                 functor(node_it);
             }
         }
@@ -221,41 +465,96 @@ public:
         DEBUG("Removing nodes..");
         auto end = End();
 
-        // Actually count for vals means id but not actually node storage size, probably should
-        // change for separate fields
-        // size_t count = 0;
         std::vector<mem::PageIndex> free_pages;
+        RemovalStats removal;
+        auto vector_index = GetVectorIndex();
+        auto quantized_index = GetQuantizedIndex();
+        std::vector<ts::ObjectId> removed_ids;
         for (auto node_it = Begin(); node_it != end;) {
             auto current_it = node_it++;
-            if (predicate(current_it)) {
-                DEBUG("Node: ", current_it->ToString());
+            if (!predicate(current_it)) {
+                removal.Kept(current_it.Id());
+            } else {
+                DEBUG("Node id: ", current_it.Id());
+                removal.Removed(current_it.GetSlot().size_);
+                RemoveLocation(current_it.Id());
+                if (vector_index.IsBuilt()) {
+                    vector_index.Remove(current_it.Id());
+                }
+                if (quantized_index.IsBuilt()) {
+                    removed_ids.push_back(current_it.Id());
+                }
+                if (current_it.IsOverflowed()) {
+                    FreeOverflow(current_it.GetRealOffset());
+                }
                 auto page = mem::ReadPage(*current_it.Page(), alloc_->GetFile());
-                auto node = *current_it;
-
-                page.actual_size_ -= node.Size();
-
-                // Not working as intended this should be a pointer from which we will iterate in
-                // page for some optimizations
-                page.initialized_offset_ =
-                    std::min(current_it.InPageOffset(), page.initialized_offset_);
-                node.Free(current_it.InPageOffset() + static_cast<mem::PageOffset>(node.Size()));
-                node.Write(alloc_->GetFile(),
-                           mem::GetOffset(current_it.Page()->index_, current_it.InPageOffset()));
+                RemoveRecord(page, current_it.SlotIndex());
 
                 DEBUG("Page: ", page);
-                mem::WritePage(page, alloc_->GetFile());
                 if (page.actual_size_ == 0) {
                     INFO("Deallocated page", page);
                     free_pages.push_back(page.index_);
                 }
-                // ++count;
             }
         }
         for (auto id : free_pages) {
+            free_space_map_.Update(id, 0);
             FreePage(id);
         }
-        // auto header = GetHeader();
-        // header.WriteNodeCount(alloc_->GetFile(), header.nodes_ - count);
+        // Map of the class without pages is empty, so its pages are freed as well
+        if (data_page_list_.IsEmpty()) {
+            free_space_map_.Drop();
+        }
+        if (!removed_ids.empty()) {
+            quantized_index.Remove(removed_ids);
+        }
+        TrimLocations();
+        CountRemoval(removal);
+    }
+
+    // Slots are kept when the record is moved inside the page, so the id is resolved by the page
+    // and the slot
+    [[nodiscard]] std::optional<Node> FindNode(ts::ObjectId id) {
+        auto location = GetLocation(id);
+        if (!location.has_value()) {
+            return std::nullopt;
+        }
+        auto& file = alloc_->GetFile();
+        auto page = mem::ReadPage(mem::Page(location->index_), file);
+        auto record = mem::ReadSlot(page, location->slot_, file);
+        auto& buffer = ts::ScratchBuffer(record.size_);
+        file->ReadBuffer(buffer.data(), mem::GetOffset(page.index_, record.offset_, file),
+                         buffer.size());
+        return Node(GetHeader().magic_, nodes_class_, file,
+                    std::string_view(buffer.data(), buffer.size()));
+    }
+
+    // Page indices change after the compaction of the file, so the maps are filled again
+    void RebuildIndices() {
+        free_space_map_.Clear();
+        for (auto& page : data_page_list_) {
+            free_space_map_.Update(page.index_, GetAvailableSpace(page));
+        }
+        auto end = End();
+        for (auto node_it = Begin(); node_it != end; ++node_it) {
+            SetLocation(node_it.Id(), NodeLocation{node_it.current_page_->index_, node_it.slot_});
+        }
+    }
+
+    // Overflow chains are not linked into the data list, so they are freed record by record
+    void Drop() {
+        std::vector<mem::Offset> overflowed;
+        auto end = End();
+        for (auto node_it = Begin(); node_it != end; ++node_it) {
+            if (node_it.IsOverflowed()) {
+                overflowed.push_back(node_it.GetRealOffset());
+            }
+        }
+        for (auto offset : overflowed) {
+            FreeOverflow(offset);
+        }
+        free_space_map_.Drop();
+        NodeStorage::Drop();
     }
 };
-}  // namespace db
\ No newline at end of file
+}  // namespace db
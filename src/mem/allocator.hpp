@@ -1,6 +1,11 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+#include <vector>
 
 #include "logger.hpp"
 #include "mem.hpp"
@@ -17,10 +22,12 @@ private:
     File::Ptr file_;
     PageList free_list_;
 
-    const double load_factor_ = 0.5;
+    // Free tail is cut while the pages are freed, so the removal of the half of the file leaves
+    // less than the half of it free
+    const double load_factor_ = 0.4;
 
     PageIndex AllocateNewPage() {
-        if ((file_->GetSize() - kPagetableOffset) % kPageSize != 0) {
+        if (static_cast<size_t>(file_->GetSize() - kPagetableOffset) % file_->GetPageSize() != 0) {
             ERROR("Filesize: ", file_->GetSize());
             throw error::StructureError("Unaligned file");
         }
@@ -29,7 +36,7 @@ private:
         DEBUG("Allocating page");
         DEBUG("Filesize: ", new_page_offset);
 
-        file_->Extend(kPageSize);
+        file_->Extend(static_cast<Offset>(file_->GetPageSize()));
         file_->Write<Page>(Page(pages_count_++), new_page_offset);
         file_->Write<size_t>(pages_count_, kPagesCountOffset);
 
@@ -38,47 +45,93 @@ private:
         return pages_count_ - 1;
     }
 
-    void SwapPages(PageIndex first, PageIndex second) {
-        if (first > pages_count_ || second > pages_count_) {
-            throw error::BadArgument("The page index exceedes pages count: " +
-                                     std::to_string(pages_count_));
+    using OwnersIndex = std::map<Offset, std::vector<PageIndex>>;
+
+    OwnersIndex BuildOwnersIndex() {
+        OwnersIndex owners;
+        for (PageIndex index = 0; index < pages_count_; ++index) {
+            auto page = ReadPage(Page(index), file_);
+            if (page.type_ != PageType::kFree) {
+                owners[page.owner_].push_back(index);
+            }
         }
+        return owners;
+    }
 
-        DEBUG("Swapping pages with indecies ", first, " ", second);
+    void Redirect(PageIndex neighbour, Offset owner, PageIndex from, PageIndex to) {
+        auto address = neighbour == kSentinelIndex ? owner : GetPageAddress(neighbour, file_);
+        auto page = file_->Read<Page>(address);
+        if (page.previous_page_index_ == from) {
+            page.previous_page_index_ = to;
+        }
+        if (page.next_page_index_ == from) {
+            page.next_page_index_ = to;
+        }
+        file_->Write<Page>(page, address);
+    }
 
-        auto first_data = file_->Read<PageData>(GetPageAddress(first));
-        auto second_data = file_->Read<PageData>(GetPageAddress(second));
+    // Sentinels of the lists could be stored inside of pages (e.g. class headers), so after the
+    // page was moved all pages of such lists should be retagged
+    void Retag(OwnersIndex& owners, PageIndex from, PageIndex to) {
+        auto delta = GetPageAddress(to, file_) - GetPageAddress(from, file_);
+        auto begin = owners.lower_bound(GetPageAddress(from, file_));
+        auto end = owners.lower_bound(GetPageAddress(from + 1, file_));
+
+        OwnersIndex retagged;
+        for (auto it = begin; it != end; ++it) {
+            for (auto index : it->second) {
+                auto page = ReadPage(Page(index), file_);
+                page.owner_ += delta;
+                WritePage(page, file_);
+            }
+            retagged.emplace(it->first + delta, std::move(it->second));
+        }
+        owners.erase(begin, end);
+        owners.merge(retagged);
+    }
 
-        std::swap(first_data.page_header.index_, second_data.page_header.index_);
-        std::swap(first_data.page_header.next_page_index_,
-                  second_data.page_header.next_page_index_);
-        std::swap(first_data.page_header.previous_page_index_,
-                  second_data.page_header.previous_page_index_);
+    void MovePage(OwnersIndex& owners, PageIndex from, PageIndex to) {
+        DEBUG("Moving page ", from, " to ", to);
 
-        file_->Write<PageData>(first_data, GetPageAddress(second_data.page_header.index_));
-        file_->Write<PageData>(second_data, GetPageAddress(first_data.page_header.index_));
+        auto data = file_->ReadVector<char>(GetPageAddress(from, file_), file_->GetPageSize());
+        Page header;
+        std::memcpy(&header, data.data(), sizeof(Page));
+        if (header.owner_ == kNoOwner) {
+            throw error::StructureError("Can't move page without owner");
+        }
+
+        free_list_.Unlink(to);
+
+        Redirect(header.previous_page_index_, header.owner_, from, to);
+        if (header.next_page_index_ != header.previous_page_index_) {
+            Redirect(header.next_page_index_, header.owner_, from, to);
+        }
+        header.index_ = to;
+        std::memcpy(data.data(), &header, sizeof(Page));
+        file_->Write(data, GetPageAddress(to, file_));
 
-        DEBUG("Successfully swaped");
+        auto& siblings = owners[header.owner_];
+        std::replace(siblings.begin(), siblings.end(), from, to);
+        Retag(owners, from, to);
+
+        WritePage(Page(from), file_);
+        free_list_.PushBack(from);
+
+        DEBUG("Successfully moved");
     }
 
-    // TODO: Need to do better compression but the problem that i need to know from which list
-    // swapping occurs, but i can't. I'm tired
-    void Compression() {
-        auto rbegin = free_list_.RBegin();
-        auto page_it = pages_count_ - 1;
+    void TruncateFreeTail() {
         size_t count = 0;
-        while (page_it != 0) {
-            DEBUG("Page: ", ReadPage(Page(page_it), file_));
-            if (ReadPage(Page(page_it), file_).type_ == PageType::kFree) {
-                --pages_count_;
-                ++count;
-                free_list_.Unlink(page_it--);
-            } else {
-                break;
-            }
+        while (pages_count_ != 0 &&
+               ReadPage(Page(pages_count_ - 1), file_).type_ == PageType::kFree) {
+            free_list_.Unlink(--pages_count_);
+            ++count;
+        }
+        if (count != 0) {
+            DEBUG("TRUNCATE: ", count * file_->GetPageSize());
+            file_->Write<size_t>(pages_count_, kPagesCountOffset);
+            file_->Truncate(static_cast<Offset>(count * file_->GetPageSize()));
         }
-        DEBUG("TRUNCATE: ", count * kPageSize);
-        file_->Truncate(count * kPageSize);
     }
 
 public:
@@ -101,6 +154,10 @@ public:
         return pages_count_;
     }
 
+    [[nodiscard]] size_t GetPageSize() const {
+        return file_->GetPageSize();
+    }
+
     [[nodiscard]] mem::File::Ptr& GetFile() {
         return file_;
     }
@@ -121,11 +178,49 @@ public:
         WritePage(Page(index), file_);
         free_list_.PushBack(index);
 
-        if (static_cast<double>(free_list_.GetPagesCount()) / pages_count_ > load_factor_) {
-            DEBUG("Compression");
-            Compression();
+        if (IsSparse()) {
+            DEBUG("Truncation");
+            TruncateFreeTail();
         }
     }
+
+    [[nodiscard]] bool IsSparse() const {
+        return pages_count_ != 0 &&
+               static_cast<double>(free_list_.GetPagesCount()) / pages_count_ > load_factor_;
+    }
+
+    // Moves live pages from the end of the file into the free ones at the beginning and then
+    // truncates the file. Returns the relocations that were made, so that everyone who caches page
+    // indicies could fix them. Must be called only when no page iterators are alive.
+    std::unordered_map<PageIndex, PageIndex> Compact() {
+        INFO("Compaction");
+        std::unordered_map<PageIndex, PageIndex> relocations;
+
+        TruncateFreeTail();
+        if (free_list_.IsEmpty()) {
+            return relocations;
+        }
+
+        std::vector<PageIndex> holes;
+        for (auto& page : free_list_) {
+            holes.push_back(page.index_);
+        }
+        std::sort(holes.begin(), holes.end());
+
+        auto owners = BuildOwnersIndex();
+        for (auto hole : holes) {
+            auto last = pages_count_ - 1;
+            if (hole >= last) {
+                break;
+            }
+            MovePage(owners, last, hole);
+            relocations.emplace(last, hole);
+            TruncateFreeTail();
+        }
+
+        INFO("Relocated ", relocations.size(), " pages, pages count: ", pages_count_);
+        return relocations;
+    }
 };
 
 }  // namespace mem
\ No newline at end of file
@@ -16,11 +16,17 @@ using FileDescriptor = int32_t;
 using Offset = off64_t;
 using StructOffset = size_t;
 
+constexpr size_t kDefaultPageSize = 4096;
+constexpr size_t kMinPageSize = 4096;
+constexpr size_t kMaxPageSize = 65536;
+
 class File {
 
     DECLARE_LOGGER;
     FileDescriptor fd_;
     std::string fileName_;
+    // Page size is chosen on database creation and is stored in the superblock
+    size_t page_size_ = kDefaultPageSize;
 
     Offset Seek(Offset offset) const {
         Offset new_offset = lseek64(fd_, offset, SEEK_SET);
@@ -51,6 +57,18 @@ public:
         return fileName_;
     }
 
+    [[nodiscard]] size_t GetPageSize() const {
+        return page_size_;
+    }
+
+    void SetPageSize(size_t page_size) {
+        if (page_size < kMinPageSize || page_size > kMaxPageSize ||
+            (page_size & (page_size - 1)) != 0) {
+            throw error::BadArgument("Invalid page size: " + std::to_string(page_size));
+        }
+        page_size_ = page_size;
+    }
+
     [[nodiscard]] Offset GetSize() const {
 
         // TODO: Adapt for Windows
@@ -109,7 +127,16 @@ public:
                  StructOffset count = SIZE_MAX) {
         count = std::min(count, vec.size() - from);
         auto new_offset = Seek(offset);
-        if (write(fd_, vec.data(), count * sizeof(T)) == -1) {
+        if (write(fd_, vec.data() + from, count * sizeof(T)) == -1) {
+            throw error::IoError("Failed to write to file " + fileName_);
+        }
+        return new_offset;
+    }
+
+    // Writes the memory of the caller, serialized records reach the file at once
+    Offset WriteBuffer(const char* buffer, Offset offset, size_t count) {
+        auto new_offset = Seek(offset);
+        if (write(fd_, buffer, count) == -1) {
             throw error::IoError("Failed to write to file " + fileName_);
         }
         return new_offset;
@@ -146,6 +173,18 @@ public:
         return str;
     }
 
+    // Reads into the memory of the caller, so the buffer could be reused
+    void ReadBuffer(char* buffer, Offset offset, size_t count) const {
+        Seek(offset);
+        auto result = read(fd_, buffer, count);
+        if (result == -1) {
+            throw error::IoError("Failed to read from file " + fileName_);
+        }
+        if (result == 0) {
+            throw error::IoError("Reached EOF");
+        }
+    }
+
     template <typename T>
     [[nodiscard]] std::vector<T> ReadVector(
         Offset offset = 0, size_t count = 0) const requires std::is_default_constructible_v<T> {
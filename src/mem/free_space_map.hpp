@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include <vector>
+
+#include "allocator.hpp"
+#include "paged_array.hpp"
+
+namespace mem {
+
+// Keeps a byte per page with the free space of the page in 1/256 of a page, so the page with
+// enough room is found without reading data pages. The file is split into chunks of pages that
+// are covered by one map page, and only the chunks with pages of the class get their map pages.
+// The directory keeps the map page of every chunk and the upper bound of its entries, so the
+// update is a write to the known page and the search reads the directory and the map pages whose
+// bounds fit
+class FreeSpaceMap {
+private:
+    DECLARE_LOGGER;
+    PageAllocator::Ptr alloc_;
+    PageList map_page_list_;
+
+    struct Chunk {
+        PageIndex map_page_;
+        size_t bound_;
+    };
+    static constexpr Chunk kNoChunk = Chunk{kSentinelIndex, 0};
+    PagedArray<Chunk> directory_;
+
+    static constexpr size_t kCategories = 256;
+    using Category = uint8_t;
+
+    [[nodiscard]] size_t GetStep() const {
+        return alloc_->GetPageSize() / kCategories;
+    }
+
+    [[nodiscard]] size_t GetCapacity() const {
+        return alloc_->GetPageSize() - sizeof(Page);
+    }
+
+    [[nodiscard]] PageIndex AllocateMapPage() {
+        DEBUG("New free space map page");
+        map_page_list_.PushBack(alloc_->AllocatePage());
+        auto page = ReadPage(Page(map_page_list_.Back()), alloc_->GetFile());
+        page.type_ = PageType::kFreeSpaceMap;
+        page.free_offset_ = static_cast<PageOffset>(alloc_->GetPageSize());
+        WritePage(page, alloc_->GetFile());
+        alloc_->GetFile()->Write(std::vector<Category>(GetCapacity(), 0),
+                                 GetOffset(page.index_, sizeof(Page), alloc_->GetFile()));
+        return page.index_;
+    }
+
+public:
+    FreeSpaceMap(std::string name, PageAllocator::Ptr& alloc, Offset sentinel_offset,
+                 Offset directory_sentinel_offset, DEFAULT_LOGGER(logger))
+        : LOGGER(logger),
+          alloc_(alloc),
+          map_page_list_(name, alloc_->GetFile(), sentinel_offset, LOGGER),
+          directory_(name + "_Directory", alloc_, directory_sentinel_offset, LOGGER) {
+    }
+
+    // Chunks without map pages are full, so the full pages don't create them
+    void Update(PageIndex index, size_t free_space) {
+        auto category = static_cast<Category>(std::min(free_space / GetStep(), kCategories - 1));
+        auto ordinal = index / GetCapacity();
+        auto chunk = ordinal < directory_.Size() ? directory_.Get(ordinal) : kNoChunk;
+        if (chunk.map_page_ == kSentinelIndex) {
+            if (category == 0) {
+                return;
+            }
+            directory_.Extend(ordinal + 1, kNoChunk);
+            chunk = Chunk{AllocateMapPage(), 0};
+        }
+        alloc_->GetFile()->Write<Category>(
+            category, GetOffset(chunk.map_page_,
+                                static_cast<PageOffset>(sizeof(Page) + index % GetCapacity()),
+                                alloc_->GetFile()));
+        if (category > chunk.bound_) {
+            chunk.bound_ = category;
+            directory_.Set(ordinal, chunk);
+        }
+    }
+
+    // Returns the page that had at least size free bytes on the last update, bounds of the chunks
+    // are tightened when they turn out to be stale
+    [[nodiscard]] std::optional<PageIndex> Find(size_t size) {
+        auto required = (size + GetStep() - 1) / GetStep();
+        if (required >= kCategories) {
+            return std::nullopt;
+        }
+        auto chunks = directory_.ReadAll();
+        for (size_t ordinal = 0; ordinal < chunks.size(); ++ordinal) {
+            auto& chunk = chunks[ordinal];
+            if (chunk.map_page_ == kSentinelIndex || chunk.bound_ < required) {
+                continue;
+            }
+            auto entries = alloc_->GetFile()->ReadVector<Category>(
+                GetOffset(chunk.map_page_, sizeof(Page), alloc_->GetFile()), GetCapacity());
+            auto found = std::find_if(entries.begin(), entries.end(),
+                                      [required](Category c) { return c >= required; });
+            if (found != entries.end()) {
+                return ordinal * GetCapacity() +
+                       static_cast<size_t>(std::distance(entries.begin(), found));
+            }
+            chunk.bound_ = *std::max_element(entries.begin(), entries.end());
+            directory_.Set(ordinal, chunk);
+        }
+        return std::nullopt;
+    }
+
+    // Map pages are moved by the compaction, so the map is built again from the start
+    void Clear() {
+        Drop();
+    }
+
+    void Drop() {
+        while (!map_page_list_.IsEmpty()) {
+            auto index = map_page_list_.Back();
+            map_page_list_.PopBack();
+            alloc_->FreePage(index);
+        }
+        directory_.Drop();
+    }
+};
+
+}  // namespace mem
@@ -1,5 +1,8 @@
 #pragma once
+#include <algorithm>
 #include <cstddef>
+#include <optional>
+#include <vector>
 
 #include "file.hpp"
 #include "page.hpp"
@@ -7,7 +10,12 @@
 namespace mem {
 
 using GlobalMagic = uint64_t;
-constexpr inline GlobalMagic kMagic = 0xDEADBEEF;
+// Files of the first format had the bare magic, the later ones keep the version of the layout of
+// the pages and the headers in its low half, so a file of another version is rejected before it's
+// read. The version is bumped by every change of the layout
+constexpr inline GlobalMagic kLegacyMagic = 0xDEADBEEF;
+constexpr inline GlobalMagic kFormatVersion = 6;
+constexpr inline GlobalMagic kMagic = 0xDAEDA1D5'00000000 | kFormatVersion;
 
 // Constant offsets of some data in superblock for more precise changes
 constexpr Offset kFreeListSentinelOffset = sizeof(GlobalMagic);
@@ -16,8 +24,11 @@ constexpr Offset kFreePagesCountOffset =
 constexpr Offset kPagesCountOffset = kFreePagesCountOffset + static_cast<Offset>(sizeof(Offset));
 constexpr Offset kClassListSentinelOffset = kPagesCountOffset + static_cast<Offset>(sizeof(size_t));
 constexpr Offset kClassListCount = kClassListSentinelOffset + static_cast<Offset>(sizeof(Page));
+constexpr Offset kPageSizeOffset = kClassListCount + static_cast<Offset>(sizeof(size_t));
+constexpr Offset kCatalogSentinelOffset = kPageSizeOffset + static_cast<Offset>(sizeof(size_t));
+constexpr Offset kCatalogCount = kCatalogSentinelOffset + static_cast<Offset>(sizeof(Page));
 
-constexpr Offset kPagetableOffset = kClassListCount + static_cast<Offset>(sizeof(size_t));
+constexpr Offset kPagetableOffset = kCatalogCount + static_cast<Offset>(sizeof(size_t));
 
 constexpr PageIndex kSentinelIndex = SIZE_MAX;
 
@@ -28,16 +39,32 @@ public:
     size_t pages_count;
     Page class_list_sentinel_;
     size_t class_list_count_;
+    size_t page_size_;
+    // Snapshot of the class headers, so they aren't read one by one on open
+    Page catalog_sentinel_;
+    size_t catalog_pages_count_;
 
-    void CheckConsistency(File::Ptr& file) {
+    [[nodiscard]] static std::optional<GlobalMagic> ReadMagic(File::Ptr& file) {
         try {
-            auto magic = file->Read<GlobalMagic>();
-            if (magic != kMagic) {
-                throw error::StructureError("Can't open database from this file: " +
-                                            file->GetFilename());
-            }
-
+            return file->Read<GlobalMagic>();
         } catch (...) {
+            return std::nullopt;
+        }
+    }
+
+    // File of the database, but of the format that this version can't read
+    [[nodiscard]] static bool IsOtherFormat(File::Ptr& file) {
+        auto magic = ReadMagic(file);
+        return magic.has_value() && magic != kMagic &&
+               (magic == kLegacyMagic || *magic >> 32 == kMagic >> 32);
+    }
+
+    void CheckConsistency(File::Ptr& file) {
+        if (IsOtherFormat(file)) {
+            throw error::StructureError("Unsupported format version of the database file: " +
+                                        file->GetFilename());
+        }
+        if (ReadMagic(file) != kMagic) {
             throw error::StructureError("Can't open database from this file: " +
                                         file->GetFilename());
         }
@@ -47,10 +74,12 @@ public:
         CheckConsistency(file);
         auto header = file->Read<Superblock>(sizeof(kMagic));
         std::swap(header, *this);
+        file->SetPageSize(page_size_);
         return *this;
     }
 
-    Superblock& InitSuperblock(File::Ptr& file) {
+    Superblock& InitSuperblock(File::Ptr& file, size_t page_size = kDefaultPageSize) {
+        file->SetPageSize(page_size);
         file->Write<GlobalMagic>(kMagic);
         free_list_sentinel_ = Page(kSentinelIndex);
         free_list_sentinel_.type_ = PageType::kSentinel;
@@ -59,6 +88,10 @@ public:
         class_list_sentinel_ = Page(kSentinelIndex);
         class_list_count_ = 0;
         class_list_sentinel_.type_ = PageType::kSentinel;
+        page_size_ = page_size;
+        catalog_sentinel_ = Page(kSentinelIndex);
+        catalog_sentinel_.type_ = PageType::kSentinel;
+        catalog_pages_count_ = 0;
 
         file->Write<Superblock>(*this, sizeof(kMagic));
         return *this;
@@ -70,6 +103,8 @@ public:
     }
 };
 
+static_assert(sizeof(GlobalMagic) + sizeof(Superblock) == kPagetableOffset);
+
 constexpr inline Offset GetCountFromSentinel(Offset sentinel) {
     return sentinel + static_cast<Offset>(sizeof(Page));
 }
@@ -78,29 +113,82 @@ constexpr inline Offset GetSentinelIndex(Offset sentinel) {
     return sentinel + static_cast<Offset>(sizeof(PageType));
 }
 
-constexpr inline Offset GetOffset(PageIndex index, PageOffset virt_offset) {
-    if (virt_offset >= mem::kPageSize) {
-        throw error::BadArgument("Invalid virtual offset");
-    }
-    return kPagetableOffset + static_cast<Offset>(index) * mem::kPageSize + virt_offset;
+inline Offset GetPageAddress(PageIndex index, const File::Ptr& file) {
+    return kPagetableOffset + static_cast<Offset>(index * file->GetPageSize());
 }
 
-constexpr inline PageIndex GetIndex(Offset offset) {
-    return static_cast<PageIndex>((offset - kPagetableOffset) / kPageSize);
+inline PageIndex GetIndex(Offset offset, const File::Ptr& file) {
+    return static_cast<PageIndex>(offset - kPagetableOffset) / file->GetPageSize();
 }
 
-constexpr inline Offset GetPageAddress(PageIndex index) {
-    return kPagetableOffset + static_cast<Offset>(index) * kPageSize;
+inline Offset GetOffset(PageIndex index, PageOffset virt_offset, const File::Ptr& file) {
+    if (virt_offset >= file->GetPageSize()) {
+        throw error::BadArgument("Invalid virtual offset");
+    }
+    return GetPageAddress(index, file) + virt_offset;
+}
+
+inline Offset GetSlotOffset(PageIndex index, PageOffset slot, const File::Ptr& file) {
+    return GetOffset(
+        index, static_cast<PageOffset>(file->GetPageSize() - (slot + 1) * sizeof(Slot)), file);
 }
 
 using Magic = uint64_t;
 
+// Compact nodes of fixed size classes have neither magic nor id, the magic is stored once per page
+// and ids are derived from the page ordinal and the slot
+enum class NodeLayout : uint32_t { kDefault, kCompact };
+
+// Statistics of the nodes of the class, updated on every insertion and removal
+struct NodeStats {
+    size_t nodes_count_;
+    size_t live_bytes_;
+    size_t min_id_;
+    size_t max_id_;
+};
+
 class ClassHeader : public Page {
+private:
+    [[nodiscard]] PageOffset FieldOffset(const auto& field) const {
+        return static_cast<PageOffset>(reinterpret_cast<const char*>(&field) -
+                                       reinterpret_cast<const char*>(this));
+    }
+
 public:
     Page node_list_sentinel_;
     size_t node_pages_count_;
     size_t id_;
     Magic magic_;
+    Page free_space_sentinel_;
+    size_t free_space_pages_count_;
+    // Maps ordinals of compact pages to their indices
+    Page page_table_sentinel_;
+    size_t page_table_pages_count_;
+    size_t page_table_size_;
+    NodeLayout layout_;
+    // Maps ids of nodes to their pages and slots
+    Page id_table_sentinel_;
+    size_t id_table_pages_count_;
+    size_t id_table_size_;
+    NodeStats stats_;
+    // Histograms and sketches written by the analysis
+    Page statistics_sentinel_;
+    size_t statistics_pages_count_;
+    // Fingerprint of the class, so the catalog is loaded without reading the classes
+    uint64_t fingerprint_;
+    // Tail of the class that doesn't fit into the header page
+    Page class_overflow_sentinel_;
+    size_t class_overflow_pages_count_;
+    // Approximate nearest neighbour index over a vector field of the nodes
+    Page vector_index_sentinel_;
+    size_t vector_index_pages_count_;
+    // Inverted file of product quantized vectors of the nodes
+    Page quantized_index_sentinel_;
+    size_t quantized_index_pages_count_;
+    // Map pages of the free space map by the chunks of the file
+    Page free_space_directory_sentinel_;
+    size_t free_space_directory_pages_count_;
+    size_t free_space_directory_size_;
 
     ClassHeader() : Page() {
         this->type_ = PageType::kClassHeader;
@@ -110,42 +198,93 @@ public:
         this->type_ = PageType::kClassHeader;
     }
 
-    Offset GetNodeListSentinelOffset() {
-        return GetOffset(index_, sizeof(Page));
+    Offset GetNodeListSentinelOffset(File::Ptr& file) {
+        return GetOffset(index_, sizeof(Page), file);
+    }
+
+    Offset GetFreeSpaceSentinelOffset(File::Ptr& file) {
+        return GetOffset(index_, FieldOffset(free_space_sentinel_), file);
+    }
+
+    Offset GetFreeSpaceDirectorySentinelOffset(File::Ptr& file) {
+        return GetOffset(index_, FieldOffset(free_space_directory_sentinel_), file);
+    }
+
+    Offset GetPageTableSentinelOffset(File::Ptr& file) {
+        return GetOffset(index_, FieldOffset(page_table_sentinel_), file);
+    }
+
+    Offset GetIdTableSentinelOffset(File::Ptr& file) {
+        return GetOffset(index_, FieldOffset(id_table_sentinel_), file);
+    }
+
+    Offset GetStatisticsSentinelOffset(File::Ptr& file) {
+        return GetOffset(index_, FieldOffset(statistics_sentinel_), file);
+    }
+
+    Offset GetClassOverflowSentinelOffset(File::Ptr& file) {
+        return GetOffset(index_, FieldOffset(class_overflow_sentinel_), file);
+    }
+
+    Offset GetVectorIndexSentinelOffset(File::Ptr& file) {
+        return GetOffset(index_, FieldOffset(vector_index_sentinel_), file);
+    }
+
+    Offset GetQuantizedIndexSentinelOffset(File::Ptr& file) {
+        return GetOffset(index_, FieldOffset(quantized_index_sentinel_), file);
+    }
+
+    ClassHeader& WriteStats(File::Ptr& file, const NodeStats& stats) {
+        stats_ = stats;
+        file->Write<NodeStats>(stats_, GetOffset(index_, FieldOffset(stats_), file));
+        return *this;
+    }
+
+    ClassHeader& WriteFingerprint(File::Ptr& file, uint64_t fingerprint) {
+        fingerprint_ = fingerprint;
+        file->Write<uint64_t>(fingerprint_, GetOffset(index_, FieldOffset(fingerprint_), file));
+        return *this;
+    }
+
+    ClassHeader& WriteLayout(File::Ptr& file, NodeLayout layout) {
+        layout_ = layout;
+        file->Write<NodeLayout>(layout_, GetOffset(index_, FieldOffset(layout_), file));
+        return *this;
     }
 
     // Should think about structure alignment in 4 following methods
 
     ClassHeader& WriteNodeId(File::Ptr& file, size_t count) {
         id_ = count;
-        file->Write<size_t>(id_, GetOffset(index_, 2 * sizeof(Page) + sizeof(size_t)));
+        file->Write<size_t>(id_, GetOffset(index_, 2 * sizeof(Page) + sizeof(size_t), file));
         return *this;
     }
 
     ClassHeader& WriteMagic(File::Ptr& file, Magic magic) {
         magic_ = magic;
-        file->Write<Magic>(magic_, GetOffset(index_, 2 * sizeof(Page) + 2 * sizeof(size_t)));
+        file->Write<Magic>(magic_, GetOffset(index_, 2 * sizeof(Page) + 2 * sizeof(size_t), file));
         return *this;
     }
 
     ClassHeader& ReadNodeId(File::Ptr& file) {
-        id_ = file->Read<size_t>(GetOffset(index_, 2 * sizeof(Page) + sizeof(size_t)));
+        id_ = file->Read<size_t>(GetOffset(index_, 2 * sizeof(Page) + sizeof(size_t), file));
         return *this;
     }
 
     ClassHeader& ReadMagic(File::Ptr& file) {
-        magic_ = file->Read<Magic>(GetOffset(index_, 2 * sizeof(Page) + 2 * sizeof(size_t)));
+        magic_ = file->Read<Magic>(GetOffset(index_, 2 * sizeof(Page) + 2 * sizeof(size_t), file));
         return *this;
     }
 
     ClassHeader& ReadClassHeader(File::Ptr& file) {
-        auto header = file->Read<ClassHeader>(GetPageAddress(index_));
+        auto header = file->Read<ClassHeader>(GetPageAddress(index_, file));
         std::swap(header, *this);
         return *this;
     }
     ClassHeader& InitClassHeader(File::Ptr& file, size_t size = 0) {
         this->type_ = PageType::kClassHeader;
-        this->initialized_offset_ = static_cast<PageOffset>(sizeof(ClassHeader) + size);
+        this->initialized_offset_ =
+            static_cast<PageOffset>(std::min(sizeof(ClassHeader) + size, file->GetPageSize()));
         this->free_offset_ = sizeof(ClassHeader);
         this->actual_size_ = size;
         node_list_sentinel_ = Page(kSentinelIndex);
@@ -153,24 +292,81 @@ public:
         node_pages_count_ = 0;
         id_ = 0;
         magic_ = 0;
-        file->Write<ClassHeader>(*this, GetPageAddress(index_));
+        free_space_sentinel_ = Page(kSentinelIndex);
+        free_space_sentinel_.type_ = PageType::kSentinel;
+        free_space_pages_count_ = 0;
+        page_table_sentinel_ = Page(kSentinelIndex);
+        page_table_sentinel_.type_ = PageType::kSentinel;
+        page_table_pages_count_ = 0;
+        page_table_size_ = 0;
+        layout_ = NodeLayout::kDefault;
+        id_table_sentinel_ = Page(kSentinelIndex);
+        id_table_sentinel_.type_ = PageType::kSentinel;
+        id_table_pages_count_ = 0;
+        id_table_size_ = 0;
+        stats_ = NodeStats{0, 0, 0, 0};
+        statistics_sentinel_ = Page(kSentinelIndex);
+        statistics_sentinel_.type_ = PageType::kSentinel;
+        statistics_pages_count_ = 0;
+        fingerprint_ = 0;
+        class_overflow_sentinel_ = Page(kSentinelIndex);
+        class_overflow_sentinel_.type_ = PageType::kSentinel;
+        class_overflow_pages_count_ = 0;
+        vector_index_sentinel_ = Page(kSentinelIndex);
+        vector_index_sentinel_.type_ = PageType::kSentinel;
+        vector_index_pages_count_ = 0;
+        quantized_index_sentinel_ = Page(kSentinelIndex);
+        quantized_index_sentinel_.type_ = PageType::kSentinel;
+        quantized_index_pages_count_ = 0;
+        free_space_directory_sentinel_ = Page(kSentinelIndex);
+        free_space_directory_sentinel_.type_ = PageType::kSentinel;
+        free_space_directory_pages_count_ = 0;
+        free_space_directory_size_ = 0;
+        file->Write<ClassHeader>(*this, GetPageAddress(index_, file));
         return *this;
     }
     ClassHeader& WriteClassHeader(File::Ptr& file) {
-        file->Write<ClassHeader>(*this, GetPageAddress(index_));
+        file->Write<ClassHeader>(*this, GetPageAddress(index_, file));
         return *this;
     }
 };
 
 inline Page ReadPage(Page other, File::Ptr& file) {
-    auto page = file->Read<Page>(GetPageAddress(other.index_));
+    auto page = file->Read<Page>(GetPageAddress(other.index_, file));
     std::swap(page, other);
     return other;
 }
 
 inline Page WritePage(Page other, File::Ptr& file) {
-    file->Write<Page>(other, GetPageAddress(other.index_));
+    file->Write<Page>(other, GetPageAddress(other.index_, file));
     return other;
 }
 
+inline Slot ReadSlot(const Page& page, PageOffset slot, File::Ptr& file) {
+    return file->Read<Slot>(GetSlotOffset(page.index_, slot, file));
+}
+
+inline void WriteSlot(const Page& page, PageOffset slot, Slot value, File::Ptr& file) {
+    file->Write<Slot>(value, GetSlotOffset(page.index_, slot, file));
+}
+
+// Whole directory is read at once, slots are returned in their order
+inline std::vector<Slot> ReadSlots(const Page& page, File::Ptr& file) {
+    if (page.slots_count_ == 0) {
+        return {};
+    }
+    auto slots = file->ReadVector<Slot>(GetSlotOffset(page.index_, page.slots_count_ - 1, file),
+                                        page.slots_count_);
+    std::reverse(slots.begin(), slots.end());
+    return slots;
+}
+
+inline void WriteSlots(const Page& page, std::vector<Slot> slots, File::Ptr& file) {
+    if (slots.empty()) {
+        return;
+    }
+    std::reverse(slots.begin(), slots.end());
+    file->Write(slots, GetSlotOffset(page.index_, static_cast<PageOffset>(slots.size() - 1), file));
+}
+
 }  // namespace mem
\ No newline at end of file
@@ -5,9 +5,18 @@
 #include "file.hpp"
 
 namespace mem {
-inline const Offset kPageSize = 4096;
-
-enum class PageType { kClassHeader, kData, kFree, kSentinel };
+enum class PageType {
+    kClassHeader,
+    kData,
+    kFree,
+    kSentinel,
+    kOverflow,
+    kFreeSpaceMap,
+    kTable,
+    kStatistics,
+    kCatalog,
+    kVectorIndex
+};
 
 constexpr inline std::string_view PageTypeToString(PageType type) {
     switch (type) {
@@ -19,6 +28,18 @@ constexpr inline std::string_view PageTypeToString(PageType type) {
             return "Free";
         case PageType::kSentinel:
             return "Sentinel";
+        case PageType::kOverflow:
+            return "Overflow";
+        case PageType::kFreeSpaceMap:
+            return "Free Space Map";
+        case PageType::kTable:
+            return "Table";
+        case PageType::kStatistics:
+            return "Statistics";
+        case PageType::kCatalog:
+            return "Catalog";
+        case PageType::kVectorIndex:
+            return "Vector Index";
         default:
             return "";
     }
@@ -27,6 +48,9 @@ constexpr inline std::string_view PageTypeToString(PageType type) {
 using PageOffset = uint32_t;
 using PageIndex = size_t;
 
+// Pages that are not linked into any list have no owner, offset 0 is always taken by the magic
+constexpr Offset kNoOwner = 0;
+
 class Page {
 public:
     PageType type_;
@@ -36,6 +60,11 @@ public:
     size_t actual_size_;
     PageIndex previous_page_index_;
     PageIndex next_page_index_;
+    // Offset of the sentinel of the list that owns the page, used to relink it after relocation
+    Offset owner_;
+    // Slot directory of slotted pages: its size and the first empty slot
+    PageOffset slots_count_;
+    PageOffset free_slot_;
 
     Page(PageIndex index)
         : type_(PageType::kFree),
@@ -44,7 +73,10 @@ public:
           free_offset_(sizeof(Page)),
           actual_size_(0),
           previous_page_index_(index_),
-          next_page_index_(index_) {
+          next_page_index_(index_),
+          owner_(kNoOwner),
+          slots_count_(0),
+          free_slot_(0) {
     }
 
     Page() : Page(0) {
@@ -53,13 +85,21 @@ public:
         return os << " [ " << page.index_ << " ] type: " << PageTypeToString(page.type_)
                   << ", init: " << page.initialized_offset_ << ", free: " << page.free_offset_
                   << ", size: " << page.actual_size_ << ", prev: " << page.previous_page_index_
-                  << ", next: " << page.next_page_index_;
+                  << ", next: " << page.next_page_index_ << ", owner: " << page.owner_
+                  << ", slots: " << page.slots_count_;
     }
 };
 
-struct PageData {
-    Page page_header;
-    char bytes[kPageSize - sizeof(Page)];
+// Pages are at most 64 KiB, so offsets and sizes in the page fit the half of the offset
+using SlotOffset = uint16_t;
+
+// Entry of the slot directory that grows from the end of the slotted page towards its data
+struct Slot {
+    SlotOffset offset_;
+    SlotOffset size_;
 };
 
+// Offset 0 is always taken by the page header
+constexpr SlotOffset kEmptySlot = 0;
+
 }  // namespace mem
\ No newline at end of file
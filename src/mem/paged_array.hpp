@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "allocator.hpp"
+
+namespace mem {
+
+// Array of blocks of the same size stored in the chain of pages, the size of the array follows
+// the pages count of the chain. Indices of the pages are read once, so the access costs one read
+class PagedBlocks {
+private:
+    DECLARE_LOGGER;
+    PageAllocator::Ptr alloc_;
+    PageList page_list_;
+    Offset size_offset_;
+    size_t size_;
+    size_t block_size_;
+    std::vector<PageIndex> pages_;
+
+public:
+    PagedBlocks(std::string name, PageAllocator::Ptr& alloc, Offset sentinel_offset,
+                size_t block_size, DEFAULT_LOGGER(logger))
+        : LOGGER(logger),
+          alloc_(alloc),
+          page_list_(std::move(name), alloc_->GetFile(), sentinel_offset, LOGGER),
+          size_offset_(GetCountFromSentinel(sentinel_offset) +
+                       static_cast<Offset>(sizeof(size_t))),
+          size_(alloc_->GetFile()->Read<size_t>(size_offset_)),
+          block_size_(block_size) {
+        if (block_size_ == 0 || GetCapacity() == 0) {
+            throw error::BadArgument("Block doesn't fit into the page");
+        }
+    }
+
+    [[nodiscard]] size_t Size() const {
+        return size_;
+    }
+
+    // Blocks in one page
+    [[nodiscard]] size_t GetCapacity() const {
+        return (alloc_->GetPageSize() - sizeof(Page)) / block_size_;
+    }
+
+    [[nodiscard]] Offset GetBlockOffset(size_t index) {
+        if (index >= size_) {
+            throw error::BadArgument("Index is out of range");
+        }
+        if (pages_.size() != page_list_.GetPagesCount()) {
+            pages_.clear();
+            for (auto& page : page_list_) {
+                pages_.push_back(page.index_);
+            }
+        }
+        return GetOffset(
+            pages_[index / GetCapacity()],
+            static_cast<PageOffset>(sizeof(Page) + index % GetCapacity() * block_size_),
+            alloc_->GetFile());
+    }
+
+    // Blocks are visited page by page, so the caller reads the blocks of the page at once
+    template <typename Functor>
+    requires std::is_invocable_v<Functor, Offset, size_t>
+    void VisitPages(Functor functor) {
+        auto left = size_;
+        for (auto& page : page_list_) {
+            if (left == 0) {
+                break;
+            }
+            auto count = std::min(left, GetCapacity());
+            functor(GetOffset(page.index_, sizeof(Page), alloc_->GetFile()), count);
+            left -= count;
+        }
+    }
+
+    // New blocks are left as they were in the pages, they should be written by the caller
+    void Extend(size_t size) {
+        if (size <= size_) {
+            return;
+        }
+        while (page_list_.GetPagesCount() * GetCapacity() < size) {
+            DEBUG("New table page");
+            page_list_.PushBack(alloc_->AllocatePage());
+            auto page = ReadPage(Page(page_list_.Back()), alloc_->GetFile());
+            page.type_ = PageType::kTable;
+            WritePage(page, alloc_->GetFile());
+        }
+        size_ = size;
+        alloc_->GetFile()->Write<size_t>(size_, size_offset_);
+    }
+
+    size_t PushBack() {
+        Extend(size_ + 1);
+        return size_ - 1;
+    }
+
+    // Pages that are left empty are freed, the array could only shrink
+    void Resize(size_t size) {
+        if (size >= size_) {
+            return;
+        }
+        size_ = size;
+        alloc_->GetFile()->Write<size_t>(size_, size_offset_);
+        while (page_list_.GetPagesCount() * GetCapacity() >= size_ + GetCapacity() &&
+               !page_list_.IsEmpty()) {
+            auto index = page_list_.Back();
+            page_list_.PopBack();
+            alloc_->FreePage(index);
+            pages_.clear();
+        }
+    }
+
+    void Drop() {
+        while (!page_list_.IsEmpty()) {
+            auto index = page_list_.Back();
+            page_list_.PopBack();
+            alloc_->FreePage(index);
+        }
+        size_ = 0;
+        pages_.clear();
+        alloc_->GetFile()->Write<size_t>(size_, size_offset_);
+    }
+};
+
+// Array of trivially copyable values, every value is a block
+template <typename T>
+requires std::is_trivially_copyable_v<T>
+class PagedArray {
+private:
+    PageAllocator::Ptr alloc_;
+    PagedBlocks blocks_;
+
+public:
+    PagedArray(std::string name, PageAllocator::Ptr& alloc, Offset sentinel_offset,
+               DEFAULT_LOGGER(logger))
+        : alloc_(alloc), blocks_(std::move(name), alloc, sentinel_offset, sizeof(T), logger) {
+    }
+
+    [[nodiscard]] size_t Size() const {
+        return blocks_.Size();
+    }
+
+    [[nodiscard]] T Get(size_t index) {
+        return alloc_->GetFile()->Read<T>(blocks_.GetBlockOffset(index));
+    }
+
+    void Set(size_t index, const T& value) {
+        alloc_->GetFile()->Write<T>(value, blocks_.GetBlockOffset(index));
+    }
+
+    size_t PushBack(const T& value) {
+        auto index = blocks_.PushBack();
+        Set(index, value);
+        return index;
+    }
+
+    // Array is grown to the size with the copies of the value, written by one call per page
+    void Extend(size_t size, const T& value) {
+        auto index = Size();
+        blocks_.Extend(size);
+        auto capacity = blocks_.GetCapacity();
+        while (index < size) {
+            auto count = std::min(size - index, capacity - index % capacity);
+            alloc_->GetFile()->Write(std::vector<T>(count, value), blocks_.GetBlockOffset(index));
+            index += count;
+        }
+    }
+
+    // Values are read by one call per page
+    [[nodiscard]] std::vector<T> ReadAll() {
+        std::vector<T> values;
+        values.reserve(Size());
+        blocks_.VisitPages([&](Offset offset, size_t count) {
+            auto chunk = alloc_->GetFile()->template ReadVector<T>(offset, count);
+            values.insert(values.end(), chunk.begin(), chunk.end());
+        });
+        return values;
+    }
+
+    void Resize(size_t size) {
+        blocks_.Resize(size);
+    }
+
+    void Drop() {
+        blocks_.Drop();
+    }
+};
+
+}  // namespace mem
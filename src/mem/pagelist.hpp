@@ -118,6 +118,7 @@ public:
         next->previous_page_index_ = prev->index_;
         it->previous_page_index_ = it->index_;
         it->next_page_index_ = it->index_;
+        it->owner_ = kNoOwner;
 
         if (GetPagesCount() == 1) {
             next->next_page_index_ = next->index_;
@@ -140,6 +141,7 @@ public:
 
         it->next_page_index_ = other->index_;
         it->previous_page_index_ = prev->index_;
+        it->owner_ = sentinel_offset_;
         prev->next_page_index_ = it->index_;
         other->previous_page_index_ = it->index_;
 
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+#include "new.hpp"
+
+#define DDB_PARENS ()
+#define DDB_EXPAND(...) DDB_EXPAND3(DDB_EXPAND3(DDB_EXPAND3(DDB_EXPAND3(__VA_ARGS__))))
+#define DDB_EXPAND3(...) DDB_EXPAND2(DDB_EXPAND2(DDB_EXPAND2(DDB_EXPAND2(__VA_ARGS__))))
+#define DDB_EXPAND2(...) DDB_EXPAND1(DDB_EXPAND1(DDB_EXPAND1(DDB_EXPAND1(__VA_ARGS__))))
+#define DDB_EXPAND1(...) __VA_ARGS__
+
+// Applies the macro to every field, up to 64 fields are supported
+#define DDB_FOR_EACH(MACRO, TYPE, ...) \
+    __VA_OPT__(DDB_EXPAND(DDB_FOR_EACH_HELPER(MACRO, TYPE, __VA_ARGS__)))
+#define DDB_FOR_EACH_HELPER(MACRO, TYPE, FIELD, ...) \
+    MACRO(TYPE, FIELD) __VA_OPT__(DDB_FOR_EACH_AGAIN DDB_PARENS(MACRO, TYPE, __VA_ARGS__))
+#define DDB_FOR_EACH_AGAIN() DDB_FOR_EACH_HELPER
+
+#define DDB_BIND_FIELD(TYPE, FIELD) ts::MakeField(#FIELD, &TYPE::FIELD),
+
+// Binds the plain struct to the class named after it, should be used in the global namespace:
+//     struct Person { std::string name; int age; };
+//     DDB_STRUCT(Person, name, age)
+#define DDB_STRUCT(TYPE, ...)                                               \
+    template <>                                                             \
+    struct ts::Binding<TYPE> {                                              \
+        static constexpr std::string_view kName = #TYPE;                    \
+        static constexpr auto kFields =                                     \
+            std::tuple{DDB_FOR_EACH(DDB_BIND_FIELD, TYPE, __VA_ARGS__)};    \
+    };
+
+namespace ts {
+
+template <typename T, typename M>
+struct Field {
+    using Member = M;
+    std::string_view name_;
+    M T::*member_;
+};
+
+template <typename T, typename M>
+[[nodiscard]] constexpr Field<T, M> MakeField(std::string_view name, M T::*member) {
+    return Field<T, M>{name, member};
+}
+
+// Specialized by DDB_STRUCT
+template <typename T>
+struct Binding;
+
+template <typename T>
+concept Bound = requires {
+    Binding<T>::kFields;
+};
+
+template <typename M>
+concept Bindable = std::is_same_v<M, std::string> || Bound<M> ||
+                   (std::is_arithmetic_v<M> && PrimitiveKind<M>() != kUnknownKind);
+
+template <Bound T, typename Value, typename Functor>
+void ForEachField(Value& value, Functor&& functor) {
+    std::apply([&](const auto&... field) { (functor(field.name_, value.*field.member_), ...); },
+               Binding<T>::kFields);
+}
+
+template <typename F>
+using MemberOf = typename std::remove_cvref_t<F>::Member;
+
+[[nodiscard]] constexpr std::optional<size_t> SumSizes(
+    std::initializer_list<std::optional<size_t>> sizes) {
+    size_t total = 0;
+    for (auto& size : sizes) {
+        if (!size.has_value()) {
+            return std::nullopt;
+        }
+        total += size.value();
+    }
+    return total;
+}
+
+// Size of the record known at compile time, nothing for the structs with strings
+template <Bindable M>
+[[nodiscard]] constexpr std::optional<size_t> FixedSize() {
+    if constexpr (std::is_arithmetic_v<M>) {
+        return sizeof(M);
+    } else if constexpr (std::is_same_v<M, std::string>) {
+        return std::nullopt;
+    } else {
+        return std::apply(
+            [](const auto&... field) {
+                return SumSizes({FixedSize<MemberOf<decltype(field)>>()...});
+            },
+            Binding<M>::kFields);
+    }
+}
+
+// Class names can't contain '_', so it's replaced by '-' that identifiers never contain
+[[nodiscard]] inline std::string BoundName(std::string_view identifier) {
+    auto name = std::string(identifier);
+    std::replace(name.begin(), name.end(), '_', '-');
+    return name;
+}
+
+template <Bindable M>
+[[nodiscard]] Class::Ptr BindClass(std::string name) {
+    if constexpr (std::is_arithmetic_v<M>) {
+        return NewClass<PrimitiveClass<M>>(std::move(name));
+    } else if constexpr (std::is_same_v<M, std::string>) {
+        return NewClass<StringClass>(std::move(name));
+    } else {
+        auto new_class = NewClass<StructClass>(std::move(name));
+        std::apply(
+            [&new_class](const auto&... field) {
+                (new_class->AddField(
+                     BindClass<MemberOf<decltype(field)>>(BoundName(field.name_))),
+                 ...);
+            },
+            Binding<M>::kFields);
+        return new_class;
+    }
+}
+
+// Class is built once, so every use of the binding is found by the same class
+template <Bound T>
+[[nodiscard]] const StructClass::Ptr& ClassOf() {
+    static const auto kClass =
+        std::static_pointer_cast<StructClass>(BindClass<T>(BoundName(Binding<T>::kName)));
+    return kClass;
+}
+
+// Encoding follows the format of the objects: primitives as is, strings after their size and
+// structs field by field
+template <Bindable M>
+[[nodiscard]] size_t EncodedSize(const M& value) {
+    if constexpr (std::is_arithmetic_v<M>) {
+        return sizeof(M);
+    } else if constexpr (std::is_same_v<M, std::string>) {
+        return sizeof(String::SizeType) + value.size();
+    } else {
+        size_t size = 0;
+        ForEachField<M>(value, [&size](std::string_view, const auto& member) {
+            size += EncodedSize(member);
+        });
+        return size;
+    }
+}
+
+template <Bindable M>
+void Encode(const M& value, char*& out) {
+    if constexpr (std::is_arithmetic_v<M>) {
+        std::memcpy(out, &value, sizeof(M));
+        out += sizeof(M);
+    } else if constexpr (std::is_same_v<M, std::string>) {
+        auto size = static_cast<String::SizeType>(value.size());
+        std::memcpy(out, &size, sizeof(String::SizeType));
+        std::memcpy(out + sizeof(String::SizeType), value.data(), value.size());
+        out += sizeof(String::SizeType) + value.size();
+    } else {
+        ForEachField<M>(value, [&out](std::string_view, const auto& member) {
+            Encode(member, out);
+        });
+    }
+}
+
+template <Bindable M>
+void Decode(M& value, const char*& in) {
+    if constexpr (std::is_arithmetic_v<M>) {
+        std::memcpy(&value, in, sizeof(M));
+        in += sizeof(M);
+    } else if constexpr (std::is_same_v<M, std::string>) {
+        String::SizeType size;
+        std::memcpy(&size, in, sizeof(String::SizeType));
+        value.assign(in + sizeof(String::SizeType), size);
+        in += sizeof(String::SizeType) + size;
+    } else {
+        ForEachField<M>(value, [&in](std::string_view, auto& member) { Decode(member, in); });
+    }
+}
+
+// Values are read from the file one by one, since the sizes of strings are known only after they
+// are read
+template <Bindable M>
+void Decode(M& value, mem::File::Ptr& file, mem::Offset& offset) {
+    if constexpr (std::is_arithmetic_v<M>) {
+        value = file->Read<M>(offset);
+        offset += static_cast<mem::Offset>(sizeof(M));
+    } else if constexpr (std::is_same_v<M, std::string>) {
+        auto size = file->Read<String::SizeType>(offset);
+        value = size == 0 ? std::string()
+                          : file->ReadString(
+                                offset + static_cast<mem::Offset>(sizeof(String::SizeType)), size);
+        offset += static_cast<mem::Offset>(sizeof(String::SizeType) + size);
+    } else {
+        ForEachField<M>(value, [&file, &offset](std::string_view, auto& member) {
+            Decode(member, file, offset);
+        });
+    }
+}
+
+template <Bindable M>
+[[nodiscard]] std::string BoundToString(std::string_view name, const M& value) {
+    auto result = std::string(name);
+    if constexpr (std::is_same_v<M, bool>) {
+        return result + ": " + (value ? "true" : "false");
+    } else if constexpr (std::is_arithmetic_v<M>) {
+        return result + ": " + std::to_string(value);
+    } else if constexpr (std::is_same_v<M, std::string>) {
+        return result + ": \"" + value + "\"";
+    } else {
+        result.append(": { ");
+        bool first = true;
+        ForEachField<M>(value, [&](std::string_view field_name, const auto& member) {
+            result.append(first ? "" : ", ").append(BoundToString(field_name, member));
+            first = false;
+        });
+        return result.append(" }");
+    }
+}
+
+// Node data encoded straight from the bound struct without the tree of the objects
+template <Bound T>
+class BoundObject : public Object {
+    T value_;
+
+public:
+    using Ptr = util::Ptr<BoundObject<T>>;
+
+    explicit BoundObject(T value) : value_(std::move(value)) {
+        this->class_ = ClassOf<T>();
+    }
+    [[nodiscard]] const T& Value() const {
+        return value_;
+    }
+    [[nodiscard]] size_t Size() const override {
+        return EncodedSize(value_);
+    }
+    mem::Offset Write(mem::File::Ptr& file, mem::Offset offset) const override {
+        return WriteBuffered(file, offset);
+    }
+    void Read(mem::File::Ptr& file, mem::Offset offset) override {
+        if (!ReadBuffered(file, offset)) {
+            Decode(value_, file, offset);
+        }
+    }
+    size_t Write(char* buffer) const override {
+        auto out = buffer;
+        Encode(value_, out);
+        return static_cast<size_t>(out - buffer);
+    }
+    size_t Read(const char* buffer) override {
+        auto in = buffer;
+        Decode(value_, in);
+        return static_cast<size_t>(in - buffer);
+    }
+    [[nodiscard]] std::string ToString() const override {
+        return BoundToString(Binding<T>::kName, value_);
+    }
+};
+
+}  // namespace ts
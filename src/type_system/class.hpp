@@ -1,11 +1,77 @@
 #pragma once
+#include <cstdint>
+#include <iterator>
 #include <optional>
+#include <string>
 #include <string_view>
+#include <type_traits>
 
 #include "utils.hpp"
 
+#define DDB_PRIMITIVE_GENERATOR(MACRO) \
+    MACRO(int)                         \
+    MACRO(double)                      \
+    MACRO(float)                       \
+    MACRO(bool)                        \
+    MACRO(unsigned int)                \
+    MACRO(short int)                   \
+    MACRO(short unsigned int)          \
+    MACRO(long long int)               \
+    MACRO(long long unsigned int)      \
+    MACRO(long unsigned int)           \
+    MACRO(long int)                    \
+    MACRO(char)                        \
+    MACRO(signed char)                 \
+    MACRO(unsigned char)               \
+    MACRO(unsigned long)               \
+    MACRO(wchar_t)
+
 namespace ts {
 
+// Compact tag of the class, objects are dispatched by it instead of the chains of casts. Kinds of
+// primitives follow the order of DDB_PRIMITIVE_GENERATOR
+using Kind = uint8_t;
+
+constexpr Kind kStructKind = 0;
+constexpr Kind kStringKind = 1;
+constexpr Kind kRelationKind = 2;
+constexpr Kind kVectorKind = 3;
+constexpr Kind kPrimitiveKind = 4;
+constexpr Kind kUnknownKind = UINT8_MAX;
+
+// Types repeated in the generator get the kind of their first occurrence
+template <typename T>
+[[nodiscard]] consteval Kind PrimitiveKind() {
+    Kind kind = kPrimitiveKind;
+#define DDB_PRIMITIVE_KIND(P)      \
+    if (std::is_same_v<T, P>) {    \
+        return kind;               \
+    }                              \
+    ++kind;
+    DDB_PRIMITIVE_GENERATOR(DDB_PRIMITIVE_KIND)
+#undef DDB_PRIMITIVE_KIND
+    return kUnknownKind;
+}
+
+// Calls the functor with std::type_identity of the primitive type through the table indexed by
+// the kind
+template <typename Functor>
+decltype(auto) VisitPrimitive(Kind kind, Functor&& functor) {
+    using Result = decltype(functor(std::type_identity<int>{}));
+    using Visitor = Result (*)(Functor&);
+    static constexpr Visitor kVisitors[] = {
+#define DDB_PRIMITIVE_VISITOR(P) \
+    [](Functor& visitor) -> Result { return visitor(std::type_identity<P>{}); },
+        DDB_PRIMITIVE_GENERATOR(DDB_PRIMITIVE_VISITOR)
+#undef DDB_PRIMITIVE_VISITOR
+    };
+    auto index = static_cast<size_t>(kind - kPrimitiveKind);
+    if (kind < kPrimitiveKind || index >= std::size(kVisitors)) {
+        throw error::TypeError("Class isn't primitive");
+    }
+    return kVisitors[index](functor);
+}
+
 // WARN: Is compiler dependent
 template <typename T>
 [[nodiscard]] constexpr std::string_view TypeName() {
@@ -21,9 +87,44 @@ template <typename T>
     return __PRETTY_FUNCTION__;
 }
 
+// Stable hash of the binary form of the class, classes are looked up by it in the catalog
+using Fingerprint = uint64_t;
+
+// Values of the binary form are written as is, names after their sizes
+template <typename T>
+void EncodeValue(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+inline void EncodeName(std::string& out, const std::string& name) {
+    EncodeValue(out, static_cast<uint16_t>(name.size()));
+    out.append(name);
+}
+
+// FNV-1a, unlike std::hash it's the same on every run
+[[nodiscard]] constexpr Fingerprint FingerprintOf(std::string_view data) {
+    Fingerprint hash = 14695981039346656037ull;
+    for (auto c : data) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
 class Class {
 protected:
     std::string name_;
+    Kind kind_;
+    Fingerprint fingerprint_ = 0;
+    // Classes built of this one cache its layout and fingerprint, so it isn't changed any more
+    bool frozen_ = false;
+
+    // Called by the constructors of the final classes and after every change of the class
+    void UpdateFingerprint() {
+        std::string encoded;
+        Encode(encoded);
+        fingerprint_ = FingerprintOf(encoded);
+    }
 
     // Is it necessary in Class definition ?
     void Validate() const {
@@ -37,16 +138,38 @@ protected:
 public:
     using Ptr = util::Ptr<Class>;
 
-    explicit Class(std::string name) : name_(std::move(name)) {
+    Class(std::string name, Kind kind) : name_(std::move(name)), kind_(kind) {
         Validate();
     }
     virtual ~Class() = default;
 
+    [[nodiscard]] Kind GetKind() const {
+        return kind_;
+    }
+
     [[nodiscard]] virtual std::string Serialize() const = 0;
 
+    // Binary form kept in the catalog: kind, name and the classes of the fields
+    virtual void Encode(std::string& out) const {
+        EncodeValue(out, kind_);
+        EncodeName(out, name_);
+    }
+
+    [[nodiscard]] Fingerprint GetFingerprint() const {
+        return fingerprint_;
+    }
+
+    void Freeze() {
+        frozen_ = true;
+    }
+
+    [[nodiscard]] bool IsFrozen() const {
+        return frozen_;
+    }
+
     [[nodiscard]] virtual std::optional<size_t> Size() const = 0;
 
-    [[nodiscard]] virtual std::string Name() const {
+    [[nodiscard]] virtual const std::string& Name() const {
         return name_;
     }
     [[nodiscard]] virtual size_t Count() const = 0;
@@ -1,89 +1,81 @@
 #pragma once
 
-#include <sstream>
+#include <cstring>
+#include <string>
 
 #include "object.hpp"
 #include "primitive_class.hpp"
 #include "relation_class.hpp"
 #include "string_class.hpp"
 #include "struct_class.hpp"
+#include "vector_class.hpp"
 
 namespace ts {
 class ClassObject : public Object {
-    std::string serialized_;
+    // Binary form of the class, see Class::Encode
+    std::string encoded_;
     using SizeType = uint32_t;
 
-    [[nodiscard]] std::string ReadString(std::stringstream& stream, char end) const {
-        std::string result;
-        char c;
-        stream >> c;
-        while (c != end) {
-            result += c;
-            stream >> c;
+    template <typename T>
+    [[nodiscard]] static T DecodeValue(const char*& in, const char* end) {
+        if (in + sizeof(T) > end) {
+            throw error::TypeError("Can't read correct type by this address");
         }
-        return result;
+        T value;
+        std::memcpy(&value, in, sizeof(T));
+        in += sizeof(T);
+        return value;
     }
 
-    [[nodiscard]] Class::Ptr Deserialize(std::stringstream& stream) const {
-        char del;
-        stream >> del;
-        if (del == '>') {
-            return nullptr;
-        }
-        if (del != '_') {
+    [[nodiscard]] static std::string DecodeName(const char*& in, const char* end) {
+        auto size = DecodeValue<uint16_t>(in, end);
+        if (in + size > end) {
             throw error::TypeError("Can't read correct type by this address");
         }
+        std::string name(in, size);
+        in += size;
+        return name;
+    }
 
-        auto type = ReadString(stream, '@');
-        if (type == "struct") {
-            auto name = ReadString(stream, '_');
-            stream >> del;
-            if (del != '<') {
-                throw error::TypeError("Can't read correct type by this address");
-            }
-
-            auto result = util::MakePtr<StructClass>(name);
-
-            auto field = Deserialize(stream);
-            while (field != nullptr) {
-                result->AddField(field);
-                field = Deserialize(stream);
+    [[nodiscard]] static Class::Ptr Decode(const char*& in, const char* end) {
+        auto kind = DecodeValue<Kind>(in, end);
+        auto name = DecodeName(in, end);
+        switch (kind) {
+            case kStructKind: {
+                auto result = util::MakePtr<StructClass>(std::move(name));
+                auto count = DecodeValue<uint32_t>(in, end);
+                for (uint32_t i = 0; i < count; ++i) {
+                    result->AddField(Decode(in, end));
+                }
+                return result;
             }
-            stream >> del;
-            if (del != '_') {
-                throw error::TypeError("Can't read correct type by this address");
+            case kRelationKind: {
+                auto from = Decode(in, end);
+                auto to = Decode(in, end);
+                if (DecodeValue<uint8_t>(in, end) != 0) {
+                    return util::MakePtr<RelationClass>(std::move(name), from, to,
+                                                        Decode(in, end));
+                }
+                return util::MakePtr<RelationClass>(std::move(name), from, to);
             }
-            return result;
-        } else if (type == "relation") {
-            auto name = ReadString(stream, '_');
-            auto from = Deserialize(stream);
-            auto to = Deserialize(stream);
-            stream >> del;
-            if (del == '1') {
-                return util::MakePtr<RelationClass>(name, from, to, Deserialize(stream));
-            } else if (del == '_') {
-                return util::MakePtr<RelationClass>(name, from, to);
-            } else {
-                throw error::TypeError("Can't read correct type by this address");
+            case kStringKind:
+                return util::MakePtr<StringClass>(std::move(name));
+            case kVectorKind: {
+                auto element = DecodeValue<ElementTag>(in, end);
+                auto dimension = DecodeValue<uint32_t>(in, end);
+                return util::MakePtr<VectorClass>(std::move(name), element, dimension);
             }
-        } else if (type == "string") {
-            return util::MakePtr<StringClass>(ReadString(stream, '_'));
-        } else {
-
-            auto remove_spaces = [](const char* str) -> std::string {
-                std::string s = str;
-                return {s.begin(), remove_if(s.begin(), s.end(), isspace)};
-            };
-
-#define DDB_DESERIALIZE_PRIMITIVE(P)                                      \
-    if (type == remove_spaces(#P)) {                                      \
-        return util::MakePtr<PrimitiveClass<P>>(ReadString(stream, '_')); \
+            default:
+                return VisitPrimitive(kind, [&name](auto type) -> Class::Ptr {
+                    using P = typename decltype(type)::type;
+                    return util::MakePtr<PrimitiveClass<P>>(std::move(name));
+                });
+        }
     }
-            DDB_PRIMITIVE_GENERATOR(DDB_DESERIALIZE_PRIMITIVE)
-#undef DESERIALIZE_PRIMITIVE
 
-            throw error::NotImplemented("Unsupported for deserialization type " + type);
-        }
+    void Decode() {
+        const char* in = encoded_.data();
+        class_ = Decode(in, encoded_.data() + encoded_.size());
     }
 
 public:
@@ -94,33 +86,39 @@ public:
 
     ClassObject(const Class::Ptr& holder) {
         class_ = holder;
-        serialized_ = class_->Serialize();
-    }
-    ClassObject(std::string string) : serialized_(std::move(string)) {
-        std::stringstream stream(serialized_);
-        class_ = Deserialize(stream);
+        class_->Encode(encoded_);
     }
     [[nodiscard]] size_t Size() const override {
-        return serialized_.size() + sizeof(SizeType);
+        return encoded_.size() + sizeof(SizeType);
     }
     mem::Offset Write(mem::File::Ptr& file, mem::Offset offset) const override {
-        auto new_offset = file->Write<SizeType>(static_cast<SizeType>(serialized_.size()), offset) +
-                          static_cast<mem::Offset>(sizeof(SizeType));
-        return file->Write(serialized_, new_offset);
+        return WriteBuffered(file, offset);
     }
     void Read(mem::File::Ptr& file, mem::Offset offset) override {
         SizeType size = file->Read<SizeType>(offset);
-        serialized_ = file->ReadString(offset + static_cast<mem::Offset>(sizeof(SizeType)), size);
-        std::stringstream stream{serialized_};
-        class_ = Deserialize(stream);
+        encoded_ = file->ReadString(offset + static_cast<mem::Offset>(sizeof(SizeType)), size);
+        Decode();
+    }
+    size_t Write(char* buffer) const override {
+        auto size = static_cast<SizeType>(encoded_.size());
+        std::memcpy(buffer, &size, sizeof(SizeType));
+        std::memcpy(buffer + sizeof(SizeType), encoded_.data(), size);
+        return Size();
+    }
+    size_t Read(const char* buffer) override {
+        SizeType size;
+        std::memcpy(&size, buffer, sizeof(SizeType));
+        encoded_.assign(buffer + sizeof(SizeType), size);
+        Decode();
+        return Size();
     }
     [[nodiscard]] std::string ToString() const override {
-        return serialized_;
+        return class_->Serialize();
     }
 
     template <ClassLike C>
     [[nodiscard]] bool Contains(util::Ptr<C> other_class) const {
-        return serialized_.contains(ClassObject(other_class).serialized_);
+        return class_->Serialize().contains(other_class->Serialize());
     }
 };
 }  // namespace ts
\ No newline at end of file
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "class.hpp"
+
+namespace ts {
+
+// Field of the flattened class. Offset is counted from the end of the last variable sized field
+// before it, so fields of fixed size classes are found without reading the record
+struct FieldLayout {
+    const Class* class_;
+    // Index of the field among the fields of its parent
+    size_t position_;
+    std::optional<size_t> base_;
+    size_t offset_;
+    std::optional<size_t> size_;
+    // Variable sized field with its size written before it
+    bool prefixed_;
+};
+
+// Compiled once when the class is built, fields follow in the order of serialization and nested
+// fields are named by the path of their names
+class Layout {
+    struct Hash {
+        using is_transparent = void;
+        size_t operator()(std::string_view name) const {
+            return std::hash<std::string_view>{}(name);
+        }
+    };
+
+    using PrefixType = uint32_t;
+
+    std::vector<FieldLayout> fields_;
+    std::unordered_map<std::string, size_t, Hash, std::equal_to<>> names_;
+    std::optional<size_t> size_ = 0;
+
+    // The last variable sized leaf and the offset from its end while fields are added
+    std::optional<size_t> base_;
+    size_t offset_ = 0;
+
+public:
+    size_t AddField(std::string path, const Class* field_class, size_t position, bool prefixed) {
+        auto index = fields_.size();
+        names_.emplace(std::move(path), index);
+        fields_.push_back(
+            FieldLayout{field_class, position, base_, offset_, field_class->Size(), prefixed});
+        return index;
+    }
+
+    // Leaves move the offset of the next fields, structs only group them
+    void AddLeaf(size_t index) {
+        auto& field = fields_[index];
+        if (field.size_.has_value()) {
+            offset_ += field.size_.value();
+            if (size_.has_value()) {
+                size_ = size_.value() + field.size_.value();
+            }
+        } else {
+            base_ = index;
+            offset_ = 0;
+            size_ = std::nullopt;
+        }
+    }
+
+    // Bytes of the field that aren't fields themselves, like the ids of the relation
+    void Skip(size_t size) {
+        offset_ += size;
+        if (size_.has_value()) {
+            size_ = size_.value() + size;
+        }
+    }
+
+    [[nodiscard]] std::optional<size_t> Size() const {
+        return size_;
+    }
+
+    [[nodiscard]] std::optional<size_t> Find(std::string_view path) const {
+        auto it = names_.find(path);
+        if (it == names_.end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    [[nodiscard]] const FieldLayout& Get(size_t index) const {
+        return fields_[index];
+    }
+
+    // Only the variable sized fields before the field are read from the record
+    [[nodiscard]] size_t GetOffset(size_t index, std::string_view record) const {
+        auto& field = fields_[index];
+        if (!field.base_.has_value()) {
+            return field.offset_;
+        }
+        auto base_index = field.base_.value();
+        if (!fields_[base_index].prefixed_) {
+            throw error::NotImplemented("Offset after the variable sized field without prefix");
+        }
+        auto base = GetOffset(base_index, record);
+        if (base + sizeof(PrefixType) > record.size()) {
+            throw error::StructureError("Field is out of the record");
+        }
+        PrefixType size;
+        std::memcpy(&size, record.data() + base, sizeof(PrefixType));
+        return base + sizeof(PrefixType) + size + field.offset_;
+    }
+};
+
+}  // namespace ts
@@ -1,13 +1,17 @@
 #pragma once
 
-#include <any>
-#include <initializer_list>
+#include <array>
+#include <span>
 #include <string>
+#include <string_view>
+#include <type_traits>
 
+#include "arena.hpp"
 #include "primitive.hpp"
 #include "relation.hpp"
 #include "string.hpp"
 #include "struct.hpp"
+#include "vector.hpp"
 
 #define ID(id) static_cast<ts::ObjectId>(id)
 
@@ -34,140 +38,179 @@ template <ClassLike C, typename... Classes>
     }
 }
 
+// Argument of New referenced without copying, its type is encoded by the kind at compile time.
+// Vectors are passed as their bytes together with the tag of the element
+struct Argument {
+    Kind kind_;
+    const void* value_;
+    std::string_view string_;
+    ElementTag element_;
+};
+
+template <typename A>
+[[nodiscard]] Argument MakeArgument(const A& argument) {
+    using T = std::remove_cvref_t<A>;
+    if constexpr (std::is_convertible_v<const A&, std::string_view>) {
+        return Argument{kStringKind, nullptr, std::string_view(argument), {}};
+    } else if constexpr (requires { std::span(argument); }) {
+        using E = std::remove_cv_t<typename decltype(std::span(argument))::element_type>;
+        static_assert(VectorElement<E>, "Unsupported element of vector argument");
+        auto values = std::span(argument);
+        return Argument{kVectorKind, nullptr,
+                        std::string_view(reinterpret_cast<const char*>(values.data()),
+                                         values.size_bytes()),
+                        ElementTagOf<E>()};
+    } else {
+        static_assert(PrimitiveKind<T>() != kUnknownKind, "Unsupported type of argument");
+        return Argument{PrimitiveKind<T>(), &argument, {}, {}};
+    }
+}
+
+template <typename T>
+[[nodiscard]] T ArgumentValue(const Argument& argument, const Class::Ptr& object_class) {
+    if (argument.kind_ != PrimitiveKind<T>()) {
+        throw error::TypeError(
+            "Incorrect cast or attempt to implicit type conversion of argument to class type " +
+            object_class->Serialize());
+    }
+    return *static_cast<const T*>(argument.value_);
+}
+
+template <VectorElement E>
+[[nodiscard]] std::span<const E> VectorArgumentValues(const Argument& argument,
+                                                      const Class::Ptr& object_class) {
+    if (argument.kind_ != kVectorKind || argument.element_ != ElementTagOf<E>()) {
+        throw error::TypeError(
+            "Incorrect cast or attempt to implicit type conversion of argument to class type " +
+            object_class->Serialize());
+    }
+    return std::span(reinterpret_cast<const E*>(argument.string_.data()),
+                     argument.string_.size() / sizeof(E));
+}
+
 template <ObjectLike O, ClassLike C>
-[[nodiscard]] util::Ptr<O> UnsafeNew(util::Ptr<C> object_class,
-                                     std::initializer_list<std::any>::iterator& arg_it) {
+[[nodiscard]] util::Ptr<O> UnsafeNew(util::Ptr<C> object_class, const Argument*& arg_it) {
     if constexpr (std::is_same_v<O, Struct>) {
         auto new_object = util::MakePtr<Struct>(object_class);
-        auto it = util::As<StructClass>(object_class)->GetFields().begin();
-        auto end = util::As<StructClass>(object_class)->GetFields().end();
-        for (; it != end; ++it) {
-            if (util::Is<StructClass>(*it)) {
-                new_object->AddFieldValue(UnsafeNew<Struct>(util::As<StructClass>(*it), arg_it));
-            } else if (util::Is<StringClass>(*it)) {
-                if (arg_it->type() == typeid(std::string)) {
+        auto& fields = util::As<StructClass>(object_class)->GetFields();
+        for (auto& field : fields) {
+            switch (field->GetKind()) {
+                case kStructKind:
                     new_object->AddFieldValue(
-                        util::MakePtr<String>(util::As<StringClass>(*it),
-                                              std::move(std::any_cast<std::string>(*arg_it))));
-                } else if (arg_it->type() == typeid(const char*)) {
+                        UnsafeNew<Struct>(std::static_pointer_cast<StructClass>(field), arg_it));
+                    break;
+                case kStringKind:
                     new_object->AddFieldValue(
-                        util::MakePtr<String>(util::As<StringClass>(*it),
-                                              std::move(std::any_cast<const char*>(*arg_it))));
-                } else {
-                    throw error::TypeError(
-                        "Incorrect cast or attempt to implicit type conversion of argument type " +
-                        std::string(arg_it->type().name()) + " to class type" +
-                        util::As<StringClass>(*it)->Serialize());
-                }
-                ++arg_it;
-            } else {
-
-#define DDB_ADD_PRIMITIVE(P)                                                                \
-    if (util::Is<PrimitiveClass<P>>(*it)) {                                                 \
-        if (arg_it->type() == typeid(P)) {                                                  \
-            new_object->AddFieldValue(util::MakePtr<Primitive<P>>(                          \
-                util::As<PrimitiveClass<P>>(*it), std::any_cast<P>(*arg_it++)));            \
-            continue;                                                                       \
-        } else                                                                              \
-            throw error::TypeError(                                                         \
-                "Incorrect cast or attempt to implicit type conversion of argument type " + \
-                std::string(arg_it->type().name()) + " to class type" +                     \
-                util::As<PrimitiveClass<P>>(*it)->Serialize());                             \
-    }
-
-                DDB_PRIMITIVE_GENERATOR(DDB_ADD_PRIMITIVE)
-#undef DDB_ADD_PRIMITIVE
+                        UnsafeNew<String>(std::static_pointer_cast<StringClass>(field), arg_it));
+                    break;
+                case kVectorKind: {
+                    auto vector_class = std::static_pointer_cast<VectorClass>(field);
+                    new_object->AddFieldValue(VisitElement(
+                        vector_class->Element(), [&](auto type) -> Object::Ptr {
+                            using E = typename decltype(type)::type;
+                            return UnsafeNew<Vector<E>>(vector_class, arg_it);
+                        }));
+                } break;
+                default:
+                    new_object->AddFieldValue(
+                        VisitPrimitive(field->GetKind(), [&](auto type) -> Object::Ptr {
+                            using P = typename decltype(type)::type;
+                            return UnsafeNew<Primitive<P>>(
+                                std::static_pointer_cast<PrimitiveClass<P>>(field), arg_it);
+                        }));
             }
         }
-
         return new_object;
     } else if constexpr (std::is_same_v<O, String>) {
-        if (arg_it->type() == typeid(std::string)) {
-            return util::MakePtr<String>(object_class,
-                                         std::move(std::any_cast<std::string>(*arg_it)));
-        } else if (arg_it->type() == typeid(const char*)) {
-            return util::MakePtr<String>(object_class,
-                                         std::move(std::any_cast<const char*>(*arg_it)));
+        if (arg_it->kind_ != kStringKind) {
+            throw error::TypeError(
+                "Incorrect cast or attempt to implicit type conversion of argument to class type " +
+                object_class->Serialize());
         }
-        throw error::TypeError(
-            "Incorrect cast or attempt to implicit type conversion of argument type " +
-            std::string(arg_it->type().name()) + " to class type" + object_class->Serialize());
+        return util::MakePtr<String>(object_class, std::string((arg_it++)->string_));
     } else if constexpr (std::is_same_v<O, Relation>) {
-        auto in_id = std::any_cast<ObjectId>(*arg_it++);
-        auto out_id = std::any_cast<ObjectId>(*arg_it++);
+        auto in_id = ArgumentValue<ObjectId>(*arg_it++, object_class);
+        auto out_id = ArgumentValue<ObjectId>(*arg_it++, object_class);
         if (util::As<RelationClass>(object_class)->AttributesClass().has_value()) {
             throw error::NotImplemented(": ) Attributed relations not implemented yet");
         } else {
             return util::MakePtr<Relation>(object_class, in_id, out_id);
         }
+    } else if constexpr (requires { typename O::ElementType; }) {
+        using E = typename O::ElementType;
+        return util::MakePtr<O>(util::As<VectorClass>(object_class),
+                                VectorArgumentValues<E>(*arg_it++, object_class));
     } else {
-#define DDB_ADD_PRIMITIVE(P)                                                                \
-    if constexpr (std::is_same_v<O, Primitive<P>>) {                                        \
-        if (arg_it->type() == typeid(P)) {                                                  \
-            return util::MakePtr<Primitive<P>>(util::As<PrimitiveClass<P>>(object_class),   \
-                                               std::any_cast<P>(*arg_it));                  \
-        } else                                                                              \
-            throw error::TypeError(                                                         \
-                "Incorrect cast or attempt to implicit type conversion of argument type " + \
-                std::string(arg_it->type().name()) + " to class type" +                     \
-                object_class->Serialize());                                                 \
-    }
-
-        DDB_PRIMITIVE_GENERATOR(DDB_ADD_PRIMITIVE)
-#undef DDB_ADD_PRIMITIVE
+        using T = typename O::ValueType;
+        return util::MakePtr<O>(util::As<PrimitiveClass<T>>(object_class),
+                                ArgumentValue<T>(*arg_it++, object_class));
     }
-    throw error::TypeError("Can't create object for type " + object_class->Serialize());
 }
 
+// Types of the arguments are resolved at compile time, so nothing is allocated for them and only
+// the kinds are compared against the class
 template <ObjectLike O, ClassLike C, typename... Args>
 [[nodiscard]] util::Ptr<O> New(util::Ptr<C> object_class, Args&&... args) {
-
     if (object_class->Count() != sizeof...(Args)) {
         throw error::BadArgument("Wrong number of arguments");
     }
-    std::initializer_list<std::any> list = {args...};
-    std::initializer_list<std::any>::iterator it = list.begin();
+    std::array<Argument, sizeof...(Args)> arguments = {MakeArgument(args)...};
+    const Argument* it = arguments.data();
     return UnsafeNew<O>(object_class, it);
 }
 
+[[nodiscard]] inline Object::Ptr DefaultNewObject(const Class::Ptr& object_class);
+
 template <ObjectLike O, ClassLike C>
 [[nodiscard]] util::Ptr<O> DefaultNew(util::Ptr<C> object_class) {
     if constexpr (std::is_same_v<O, Struct>) {
-        auto new_object = util::MakePtr<Struct>(object_class);
-        auto fields = util::As<StructClass>(object_class)->GetFields();
-        for (auto it = fields.begin(); it != fields.end(); ++it) {
-            if (util::Is<StructClass>(*it)) {
-                new_object->AddFieldValue(DefaultNew<Struct>(util::As<StructClass>(*it)));
-            } else if (util::Is<StringClass>(*it)) {
-                new_object->AddFieldValue(DefaultNew<String>(util::As<StringClass>(*it)));
-            } else {
-#define DDB_ADD_PRIMITIVE(P)                                                                   \
-    if (util::Is<PrimitiveClass<P>>(*it)) {                                                    \
-        new_object->AddFieldValue(DefaultNew<Primitive<P>>(util::As<PrimitiveClass<P>>(*it))); \
-        continue;                                                                              \
-    }
-                DDB_PRIMITIVE_GENERATOR(DDB_ADD_PRIMITIVE)
-#undef DDB_ADD_PRIMITIVE
-
-                throw error::TypeError("Class can't be defaulted");
-            }
+        auto new_object = util::MakeArenaPtr<Struct>(object_class);
+        auto& fields = util::As<StructClass>(object_class)->GetFields();
+        new_object->ReserveFields(fields.size());
+        for (auto& field : fields) {
+            new_object->AddFieldValue(DefaultNewObject(field));
         }
         return new_object;
     } else if constexpr (std::is_same_v<O, String>) {
-        return util::MakePtr<String>(object_class);
+        return util::MakeArenaPtr<String>(object_class);
     } else if constexpr (std::is_same_v<O, Relation>) {
         auto attribute_class = util::As<RelationClass>(object_class)->AttributesClass();
         if (attribute_class.has_value()) {
             throw error::NotImplemented(": ) Attributed relations not implemented yet");
         } else {
-            return util::MakePtr<Relation>(object_class, ID(0), ID(0));
+            return util::MakeArenaPtr<Relation>(object_class, ID(0), ID(0));
         }
     } else {
-        return util::MakePtr<O>(object_class);
+        return util::MakeArenaPtr<O>(object_class);
     }
     throw error::TypeError("Can't create object");
 }
 
+// Default object of any class, the type of the object is picked by the kind of the class
+[[nodiscard]] inline Object::Ptr DefaultNewObject(const Class::Ptr& object_class) {
+    switch (object_class->GetKind()) {
+        case kStructKind:
+            return DefaultNew<Struct>(std::static_pointer_cast<StructClass>(object_class));
+        case kStringKind:
+            return DefaultNew<String>(std::static_pointer_cast<StringClass>(object_class));
+        case kRelationKind:
+            return DefaultNew<Relation>(std::static_pointer_cast<RelationClass>(object_class));
+        case kVectorKind: {
+            auto vector_class = std::static_pointer_cast<VectorClass>(object_class);
+            return VisitElement(vector_class->Element(), [&](auto type) -> Object::Ptr {
+                using E = typename decltype(type)::type;
+                return DefaultNew<Vector<E>>(vector_class);
+            });
+        }
+        default:
+            return VisitPrimitive(object_class->GetKind(), [&](auto type) -> Object::Ptr {
+                using P = typename decltype(type)::type;
+                return DefaultNew<Primitive<P>>(
+                    std::static_pointer_cast<PrimitiveClass<P>>(object_class));
+            });
+    }
+}
+
 template <ObjectLike O, ClassLike C>
 [[nodiscard]] util::Ptr<O> ReadNew(util::Ptr<C> object_class, mem::File::Ptr& file,
                                    mem::Offset offset) {
@@ -1,35 +1,47 @@
 #pragma once
 
 #include <cstddef>
+#include <cstring>
 #include <string>
+#include <vector>
 
 #include "class.hpp"
 #include "file.hpp"
 
-#define DDB_PRIMITIVE_GENERATOR(MACRO) \
-    MACRO(int)                         \
-    MACRO(double)                      \
-    MACRO(float)                       \
-    MACRO(bool)                        \
-    MACRO(unsigned int)                \
-    MACRO(short int)                   \
-    MACRO(short unsigned int)          \
-    MACRO(long long int)               \
-    MACRO(long long unsigned int)      \
-    MACRO(long unsigned int)           \
-    MACRO(long int)                    \
-    MACRO(char)                        \
-    MACRO(signed char)                 \
-    MACRO(unsigned char)               \
-    MACRO(unsigned long)               \
-    MACRO(wchar_t)
-
 namespace ts {
 
+// Memory for serialization of one record, kept between the calls so nothing is allocated on the
+// hot path. Contents are valid until the next call on the same thread
+[[nodiscard]] inline std::vector<char>& ScratchBuffer(size_t size) {
+    thread_local std::vector<char> buffer;
+    buffer.resize(size);
+    return buffer;
+}
+
 class Object {
 protected:
     Class::Ptr class_;
 
+    // Object is serialized into the scratch buffer and written with one call
+    mem::Offset WriteBuffered(mem::File::Ptr& file, mem::Offset offset) const {
+        auto& buffer = ScratchBuffer(Size());
+        Write(buffer.data());
+        file->WriteBuffer(buffer.data(), offset, buffer.size());
+        return offset + static_cast<mem::Offset>(buffer.size());
+    }
+
+    // Objects of fixed size classes are read with one call, returns false for the others
+    bool ReadBuffered(mem::File::Ptr& file, mem::Offset offset) {
+        auto size = class_->Size();
+        if (!size.has_value()) {
+            return false;
+        }
+        auto& buffer = ScratchBuffer(size.value());
+        file->ReadBuffer(buffer.data(), offset, buffer.size());
+        Read(buffer.data());
+        return true;
+    }
+
 public:
     using Ptr = util::Ptr<Object>;
 
@@ -40,6 +52,9 @@ public:
     [[nodiscard]] virtual size_t Size() const = 0;
     virtual mem::Offset Write(mem::File::Ptr& file, mem::Offset offset) const = 0;
     virtual void Read(mem::File::Ptr& file, mem::Offset offset) = 0;
+    // Buffer counterparts of Write and Read, return the number of processed bytes
+    virtual size_t Write(char* buffer) const = 0;
+    virtual size_t Read(const char* buffer) = 0;
     [[nodiscard]] virtual std::string ToString() const = 0;
 };
 
@@ -11,6 +11,7 @@ class Primitive : public Object {
 
 public:
     using Ptr = util::Ptr<Primitive<T>>;
+    using ValueType = T;
 
     ~Primitive() = default;
     Primitive(const PrimitiveClass<T>::Ptr& argclass, T value) : value_(value) {
@@ -34,6 +35,14 @@ public:
     void Read(mem::File::Ptr& file, mem::Offset offset) override {
         value_ = file->Read<T>(offset);
     }
+    size_t Write(char* buffer) const override {
+        std::memcpy(buffer, &value_, sizeof(T));
+        return sizeof(T);
+    }
+    size_t Read(const char* buffer) override {
+        std::memcpy(&value_, buffer, sizeof(T));
+        return sizeof(T);
+    }
     [[nodiscard]] std::string ToString() const override {
         if constexpr (std::is_same_v<bool, T>) {
             return class_->Name() + ": " + (value_ ? "true" : "false");
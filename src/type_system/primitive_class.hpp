@@ -11,7 +11,8 @@ class PrimitiveClass : public Class {
 public:
     using Ptr = util::Ptr<PrimitiveClass<T>>;
 
-    explicit PrimitiveClass(std::string name) : Class(std::move(name)) {
+    explicit PrimitiveClass(std::string name) : Class(std::move(name), PrimitiveKind<T>()) {
+        UpdateFingerprint();
     }
     [[nodiscard]] std::string Serialize() const override {
         std::string result = "_";
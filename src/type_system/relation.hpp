@@ -37,17 +37,12 @@ public:
                (attributes_object_.has_value() ? attributes_object_.value()->Size() : 0);
     }
     mem::Offset Write(mem::File::Ptr& file, mem::Offset offset) const override {
-        file->Write(from_id_, offset);
-        offset += sizeof(Id);
-        file->Write(to_id_, offset);
-        offset += sizeof(Id);
-        if (attributes_object_.has_value()) {
-            return attributes_object_.value()->Write(file, offset);
-        } else {
-            return offset;
-        }
+        return WriteBuffered(file, offset);
     }
     void Read(mem::File::Ptr& file, mem::Offset offset) override {
+        if (ReadBuffered(file, offset)) {
+            return;
+        }
         from_id_ = file->Read<Id>(offset);
         offset += sizeof(Id);
         to_id_ = file->Read<Id>(offset);
@@ -56,6 +51,22 @@ public:
             attributes_object_.value()->Read(file, offset);
         }
     }
+    size_t Write(char* buffer) const override {
+        std::memcpy(buffer, &from_id_, sizeof(Id));
+        std::memcpy(buffer + sizeof(Id), &to_id_, sizeof(Id));
+        if (attributes_object_.has_value()) {
+            return 2 * sizeof(Id) + attributes_object_.value()->Write(buffer + 2 * sizeof(Id));
+        }
+        return 2 * sizeof(Id);
+    }
+    size_t Read(const char* buffer) override {
+        std::memcpy(&from_id_, buffer, sizeof(Id));
+        std::memcpy(&to_id_, buffer + sizeof(Id), sizeof(Id));
+        if (attributes_object_.has_value()) {
+            return 2 * sizeof(Id) + attributes_object_.value()->Read(buffer + 2 * sizeof(Id));
+        }
+        return 2 * sizeof(Id);
+    }
     [[nodiscard]] std::string ToString() const override {
         return std::string("relation: ")
             .append(class_->Name())
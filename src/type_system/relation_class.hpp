@@ -18,13 +18,20 @@ private:
 public:
     using Ptr = util::Ptr<RelationClass>;
     RelationClass(std::string name, ts::Class::Ptr from_class, ts::Class::Ptr to_class)
-        : ts::Class(std::move(name)), from_class_(from_class), to_class_(to_class) {
+        : ts::Class(std::move(name), kRelationKind),
+          from_class_(from_class),
+          to_class_(to_class) {
+        from_class_->Freeze();
+        to_class_->Freeze();
+        UpdateFingerprint();
     }
 
     RelationClass(std::string name, ts::Class::Ptr from_class, ts::Class::Ptr to_class,
                   ts::Class::Ptr attributes_class)
         : RelationClass(std::move(name), from_class, to_class) {
         attributes_class_ = attributes_class;
+        attributes_class->Freeze();
+        UpdateFingerprint();
     }
     ~RelationClass() = default;
 
@@ -38,6 +45,16 @@ public:
             .append(attributes_class_.has_value() ? attributes_class_.value()->Serialize() : "");
     }
 
+    void Encode(std::string& out) const override {
+        Class::Encode(out);
+        from_class_->Encode(out);
+        to_class_->Encode(out);
+        EncodeValue(out, static_cast<uint8_t>(attributes_class_.has_value()));
+        if (attributes_class_.has_value()) {
+            attributes_class_.value()->Encode(out);
+        }
+    }
+
     [[nodiscard]] std::optional<size_t> Size() const override {
         if (!attributes_class_.has_value()) {
             return 2 * sizeof(Id);
@@ -49,7 +66,7 @@ public:
         }
     }
 
-    [[nodiscard]] std::string Name() const override {
+    [[nodiscard]] const std::string& Name() const override {
         return name_;
     }
     [[nodiscard]] size_t Count() const override {
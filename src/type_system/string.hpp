@@ -6,10 +6,10 @@
 namespace ts {
 class String : public Object {
     std::string str_;
-    using SizeType = u_int32_t;
 
 public:
     using Ptr = util::Ptr<String>;
+    using SizeType = u_int32_t;
 
     ~String() = default;
 
@@ -29,14 +29,24 @@ public:
         return str_;
     }
     mem::Offset Write(mem::File::Ptr& file, mem::Offset offset) const override {
-        auto new_offset = file->Write<SizeType>(static_cast<SizeType>(str_.size()), offset) +
-                          static_cast<mem::Offset>(sizeof(SizeType));
-        return file->Write(str_, new_offset);
+        return WriteBuffered(file, offset);
     }
     void Read(mem::File::Ptr& file, mem::Offset offset) override {
         SizeType size = file->Read<SizeType>(offset);
         str_ = file->ReadString(offset + static_cast<mem::Offset>(sizeof(SizeType)), size);
     }
+    size_t Write(char* buffer) const override {
+        auto size = static_cast<SizeType>(str_.size());
+        std::memcpy(buffer, &size, sizeof(SizeType));
+        std::memcpy(buffer + sizeof(SizeType), str_.data(), size);
+        return Size();
+    }
+    size_t Read(const char* buffer) override {
+        SizeType size;
+        std::memcpy(&size, buffer, sizeof(SizeType));
+        str_.assign(buffer + sizeof(SizeType), size);
+        return Size();
+    }
     [[nodiscard]] std::string ToString() const override {
         return class_->Name() + ": \"" + str_ + "\"";
     }
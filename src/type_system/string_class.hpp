@@ -7,7 +7,8 @@ class StringClass : public Class {
 public:
     using Ptr = util::Ptr<StringClass>;
 
-    explicit StringClass(std::string name) : Class(std::move(name)) {
+    explicit StringClass(std::string name) : Class(std::move(name), kStringKind) {
+        UpdateFingerprint();
     }
     [[nodiscard]] std::string Serialize() const override {
         return "_string@" + name_ + "_";
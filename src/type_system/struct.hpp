@@ -1,11 +1,16 @@
 #pragma once
 
+#include <memory_resource>
+#include <vector>
+
+#include "arena.hpp"
 #include "object.hpp"
 #include "struct_class.hpp"
 
 namespace ts {
 class Struct : public Object {
-    std::vector<Object::Ptr> fields_;
+    // Taken from the arena of the query together with the fields
+    std::pmr::vector<Object::Ptr> fields_{util::CurrentResource()};
 
 public:
     using Ptr = util::Ptr<Struct>;
@@ -27,39 +32,57 @@ public:
         fields_.push_back(value);
     }
 
+    void ReserveFields(size_t count) {
+        fields_.reserve(count);
+    }
+
     void RemoveLAstFieldValue() {
         fields_.pop_back();
     }
 
-    [[nodiscard]] const std::vector<Object::Ptr> GetFields() const {
+    [[nodiscard]] const std::pmr::vector<Object::Ptr>& GetFields() const {
         return fields_;
     }
 
+    // Position of the field is taken from the layout of the class
     template <ObjectLike O>
-    [[nodiscard]] util::Ptr<O> GetField(std::string name) const {
-        for (auto& field : fields_) {
-            if (field->GetClass()->Name() == name) {
-                return util::As<O>(field);
-            }
+    [[nodiscard]] util::Ptr<O> GetField(std::string_view name) const {
+        auto& layout = static_cast<const StructClass*>(class_.get())->GetLayout();
+        auto index = name.find('.') == std::string_view::npos ? layout.Find(name) : std::nullopt;
+        if (!index.has_value() || layout.Get(index.value()).position_ >= fields_.size()) {
+            throw error::RuntimeError("No such field");
         }
-        throw error::RuntimeError("No such field");
+        return util::As<O>(fields_[layout.Get(index.value()).position_]);
     }
 
     mem::Offset Write(mem::File::Ptr& file, mem::Offset offset) const override {
-        mem::Offset new_offset = offset;
-        for (auto& field : fields_) {
-            field->Write(file, new_offset);
-            new_offset += field->Size();
-        }
-        return new_offset;
+        return WriteBuffered(file, offset);
     }
+    // Sizes of the variable sized fields are known only after they are read
     void Read(mem::File::Ptr& file, mem::Offset offset) override {
+        if (ReadBuffered(file, offset)) {
+            return;
+        }
         mem::Offset new_offset = offset;
         for (auto& field : fields_) {
             field->Read(file, new_offset);
             new_offset += field->Size();
         }
     }
+    size_t Write(char* buffer) const override {
+        size_t size = 0;
+        for (auto& field : fields_) {
+            size += field->Write(buffer + size);
+        }
+        return size;
+    }
+    size_t Read(const char* buffer) override {
+        size_t size = 0;
+        for (auto& field : fields_) {
+            size += field->Read(buffer + size);
+        }
+        return size;
+    }
     [[nodiscard]] std::string ToString() const override {
         std::string result = class_->Name() + ": { ";
         for (auto& field : fields_) {
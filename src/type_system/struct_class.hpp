@@ -3,20 +3,60 @@
 #include <vector>
 
 #include "class.hpp"
+#include "layout.hpp"
+#include "relation_class.hpp"
+#include "string_class.hpp"
 
 namespace ts {
 
 class StructClass : public Class {
     std::vector<Class::Ptr> fields_;
+    Layout layout_;
+
+    void Flatten(Layout& layout, const std::string& prefix) const {
+        for (size_t position = 0; position < fields_.size(); ++position) {
+            auto& field = fields_[position];
+            FlattenField(layout, field, position,
+                         prefix.empty() ? field->Name() : prefix + "." + field->Name());
+        }
+    }
+
+    // Relations are the ids followed by the attributes, so the fields after the relation are found
+    // by the strings among its attributes
+    static void FlattenField(Layout& layout, const Class::Ptr& field, size_t position,
+                             const std::string& path) {
+        auto index = layout.AddField(path, field.get(), position, field->GetKind() == kStringKind);
+        if (field->GetKind() == kStructKind) {
+            static_cast<const StructClass*>(field.get())->Flatten(layout, path);
+        } else if (field->GetKind() == kRelationKind) {
+            layout.Skip(2 * sizeof(Id));
+            auto attributes = static_cast<const RelationClass*>(field.get())->AttributesClass();
+            if (attributes.has_value()) {
+                FlattenField(layout, attributes.value(), 0,
+                             path + "." + attributes.value()->Name());
+            }
+        } else {
+            layout.AddLeaf(index);
+        }
+    }
 
 public:
     using Ptr = util::Ptr<StructClass>;
 
-    StructClass(std::string name) : Class(std::move(name)) {
+    StructClass(std::string name) : Class(std::move(name), kStructKind) {
+        UpdateFingerprint();
     }
 
+    // Layout is compiled again, the field is frozen since the layout is built of its layout
     void AddField(const Class::Ptr& field) {
+        if (frozen_) {
+            throw error::TypeError("Class is already a field of another class");
+        }
+        field->Freeze();
         fields_.push_back(field);
+        layout_ = Layout();
+        Flatten(layout_, "");
+        UpdateFingerprint();
     }
 
     [[nodiscard]] std::string Serialize() const override {
@@ -28,17 +68,20 @@ public:
         return result;
     }
 
-    [[nodiscard]] std::optional<size_t> Size() const override {
-        auto result = 0;
+    void Encode(std::string& out) const override {
+        Class::Encode(out);
+        EncodeValue(out, static_cast<uint32_t>(fields_.size()));
         for (auto& field : fields_) {
-            auto size = field->Size();
-            if (size.has_value()) {
-                result += size.value();
-            } else {
-                return std::nullopt;
-            }
+            field->Encode(out);
         }
-        return result;
+    }
+
+    [[nodiscard]] std::optional<size_t> Size() const override {
+        return layout_.Size();
+    }
+
+    [[nodiscard]] const Layout& GetLayout() const {
+        return layout_;
     }
 
     [[nodiscard]] const std::vector<Class::Ptr>& GetFields() const {
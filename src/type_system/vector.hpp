@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstring>
+#include <span>
+
+#include "aligned.hpp"
+#include "object.hpp"
+#include "vector_class.hpp"
+
+namespace ts {
+
+// Values are kept aligned for the SIMD loads and are viewed as a span without copying
+template <VectorElement T>
+class Vector : public Object {
+    util::AlignedVector<T> values_;
+
+    void CheckClass(const VectorClass::Ptr& argclass) const {
+        if (argclass->Element() != ElementTagOf<T>()) {
+            throw error::TypeError("Vector element doesn't match the class " +
+                                   argclass->Serialize());
+        }
+    }
+
+public:
+    using Ptr = util::Ptr<Vector<T>>;
+    using ElementType = T;
+
+    explicit Vector(const VectorClass::Ptr& argclass) : values_(argclass->Dimension()) {
+        CheckClass(argclass);
+        this->class_ = argclass;
+    }
+    Vector(const VectorClass::Ptr& argclass, std::span<const T> values)
+        : values_(values.begin(), values.end()) {
+        CheckClass(argclass);
+        if (values.size() != argclass->Dimension()) {
+            throw error::BadArgument("Vector dimension doesn't match the class " +
+                                     argclass->Serialize());
+        }
+        this->class_ = argclass;
+    }
+
+    [[nodiscard]] std::span<const T> Values() const {
+        return values_;
+    }
+    [[nodiscard]] std::span<T> Values() {
+        return values_;
+    }
+    [[nodiscard]] size_t Size() const override {
+        return values_.size() * sizeof(T);
+    }
+    mem::Offset Write(mem::File::Ptr& file, mem::Offset offset) const override {
+        file->WriteBuffer(reinterpret_cast<const char*>(values_.data()), offset, Size());
+        return offset + static_cast<mem::Offset>(Size());
+    }
+    void Read(mem::File::Ptr& file, mem::Offset offset) override {
+        file->ReadBuffer(reinterpret_cast<char*>(values_.data()), offset, Size());
+    }
+    size_t Write(char* buffer) const override {
+        std::memcpy(buffer, values_.data(), Size());
+        return Size();
+    }
+    size_t Read(const char* buffer) override {
+        std::memcpy(values_.data(), buffer, Size());
+        return Size();
+    }
+    [[nodiscard]] std::string ToString() const override {
+        auto result = class_->Name() + ": [";
+        for (size_t i = 0; i < values_.size(); ++i) {
+            result.append(i == 0 ? "" : ", ");
+            if constexpr (std::is_same_v<T, util::Half>) {
+                result.append(std::to_string(static_cast<float>(values_[i])));
+            } else {
+                result.append(std::to_string(values_[i]));
+            }
+        }
+        return result.append("]");
+    }
+};
+
+}  // namespace ts
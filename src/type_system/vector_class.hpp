@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "class.hpp"
+#include "half.hpp"
+
+namespace ts {
+
+template <typename T>
+concept VectorElement =
+    std::is_same_v<T, float> || std::is_same_v<T, int8_t> || std::is_same_v<T, util::Half>;
+
+// Element type of the vector is kept in the class by its tag
+using ElementTag = uint8_t;
+
+constexpr ElementTag kFloatElement = 0;
+constexpr ElementTag kInt8Element = 1;
+constexpr ElementTag kHalfElement = 2;
+
+template <VectorElement T>
+[[nodiscard]] consteval ElementTag ElementTagOf() {
+    if constexpr (std::is_same_v<T, float>) {
+        return kFloatElement;
+    } else if constexpr (std::is_same_v<T, int8_t>) {
+        return kInt8Element;
+    } else {
+        return kHalfElement;
+    }
+}
+
+// Calls the functor with std::type_identity of the element type
+template <typename Functor>
+decltype(auto) VisitElement(ElementTag element, Functor&& functor) {
+    switch (element) {
+        case kFloatElement:
+            return functor(std::type_identity<float>{});
+        case kInt8Element:
+            return functor(std::type_identity<int8_t>{});
+        case kHalfElement:
+            return functor(std::type_identity<util::Half>{});
+        default:
+            throw error::TypeError("Unknown vector element");
+    }
+}
+
+[[nodiscard]] inline std::string_view ElementName(ElementTag element) {
+    switch (element) {
+        case kFloatElement:
+            return "float";
+        case kInt8Element:
+            return "int8";
+        case kHalfElement:
+            return "half";
+        default:
+            throw error::TypeError("Unknown vector element");
+    }
+}
+
+// Embedding of the fixed dimension, its elements are stored one after another. The dimension is
+// a value of the class, so classes read from the catalog aren't bound to the template
+class VectorClass : public Class {
+    ElementTag element_;
+    uint32_t dimension_;
+
+public:
+    using Ptr = util::Ptr<VectorClass>;
+
+    VectorClass(std::string name, ElementTag element, size_t dimension)
+        : Class(std::move(name), kVectorKind),
+          element_(element),
+          dimension_(static_cast<uint32_t>(dimension)) {
+        if (element_ > kHalfElement) {
+            throw error::TypeError("Unknown vector element");
+        }
+        if (dimension == 0 || dimension > UINT32_MAX) {
+            throw error::BadArgument("Invalid vector dimension");
+        }
+        UpdateFingerprint();
+    }
+
+    [[nodiscard]] ElementTag Element() const {
+        return element_;
+    }
+
+    [[nodiscard]] size_t Dimension() const {
+        return dimension_;
+    }
+
+    [[nodiscard]] size_t ElementSize() const {
+        return VisitElement(element_,
+                            [](auto type) { return sizeof(typename decltype(type)::type); });
+    }
+
+    [[nodiscard]] std::string Serialize() const override {
+        return "_vector@" + name_ + "_<" + std::string(ElementName(element_)) + ":" +
+               std::to_string(dimension_) + ">_";
+    }
+
+    void Encode(std::string& out) const override {
+        Class::Encode(out);
+        EncodeValue(out, element_);
+        EncodeValue(out, dimension_);
+    }
+
+    [[nodiscard]] std::optional<size_t> Size() const override {
+        return dimension_ * ElementSize();
+    }
+
+    [[nodiscard]] size_t Count() const override {
+        return 1;
+    }
+};
+
+template <VectorElement T, size_t N>
+[[nodiscard]] VectorClass::Ptr NewVectorClass(std::string name) {
+    static_assert(N > 0 && N <= UINT32_MAX, "Invalid vector dimension");
+    return util::MakePtr<VectorClass>(std::move(name), ElementTagOf<T>(), N);
+}
+
+}  // namespace ts
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <memory>
+#include <memory_resource>
+#include <utility>
+
+#include "utils.hpp"
+
+namespace util {
+
+// Memory of the transient objects of this thread, replaced by the arena for its scope
+[[nodiscard]] inline std::pmr::memory_resource*& CurrentResource() {
+    thread_local std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+    return resource;
+}
+
+// Object and its control block are placed in the current resource
+template <typename T, typename... Args>
+[[nodiscard]] inline Ptr<T> MakeArenaPtr(Args&&... args) {
+    return std::allocate_shared<T>(std::pmr::polymorphic_allocator<T>(CurrentResource()),
+                                   std::forward<Args>(args)...);
+}
+
+// Objects created while the arena lives are released at once together with it, so none of them
+// should outlive the arena. Memory of the objects freed earlier is reused by the pools, so long
+// scans don't grow the arena. Arenas could be nested, the previous one is restored on exit
+class Arena {
+    static constexpr size_t kBlockSize = 1 << 16;
+
+    std::pmr::monotonic_buffer_resource blocks_;
+    std::pmr::unsynchronized_pool_resource resource_;
+    std::pmr::memory_resource* previous_;
+
+public:
+    explicit Arena(size_t block_size = kBlockSize)
+        : blocks_(block_size),
+          resource_(&blocks_),
+          previous_(std::exchange(CurrentResource(), &resource_)) {
+    }
+    ~Arena() {
+        CurrentResource() = previous_;
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    [[nodiscard]] std::pmr::memory_resource* Resource() {
+        return &resource_;
+    }
+};
+
+}  // namespace util
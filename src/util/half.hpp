@@ -0,0 +1,100 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+
+namespace util {
+
+// IEEE 754 binary16, kept as bits and converted through float with rounding to the nearest even
+class Half {
+    uint16_t bits_ = 0;
+
+    [[nodiscard]] static uint16_t FromFloat(float value) {
+        auto bits = std::bit_cast<uint32_t>(value);
+        auto sign = static_cast<uint32_t>((bits >> 16) & 0x8000);
+        auto biased = static_cast<int32_t>((bits >> 23) & 0xFF);
+        uint32_t mantissa = bits & 0x7FFFFF;
+
+        if (biased == 0xFF) {
+            return static_cast<uint16_t>(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+        }
+        auto exponent = biased - 127 + 15;
+        if (exponent >= 0x1F) {
+            return static_cast<uint16_t>(sign | 0x7C00);
+        }
+
+        uint32_t result;
+        uint32_t remainder;
+        uint32_t halfway;
+        if (exponent <= 0) {
+            // Subnormal halves, the values below the half of the smallest one are zeros
+            if (exponent < -10) {
+                return static_cast<uint16_t>(sign);
+            }
+            mantissa |= 0x800000;
+            auto shift = static_cast<uint32_t>(14 - exponent);
+            result = sign | (mantissa >> shift);
+            remainder = mantissa & ((1u << shift) - 1);
+            halfway = 1u << (shift - 1);
+        } else {
+            result = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+            remainder = mantissa & 0x1FFF;
+            halfway = 0x1000;
+        }
+        // Carry of the rounding moves into the exponent and gives infinity on overflow
+        if (remainder > halfway || (remainder == halfway && (result & 1) != 0)) {
+            ++result;
+        }
+        return static_cast<uint16_t>(result);
+    }
+
+    [[nodiscard]] static float ToFloat(uint16_t half) {
+        auto sign = static_cast<uint32_t>(half & 0x8000) << 16;
+        auto exponent = static_cast<int32_t>((half >> 10) & 0x1F);
+        uint32_t mantissa = half & 0x3FF;
+
+        if (exponent == 0x1F) {
+            return std::bit_cast<float>(sign | 0x7F800000 | (mantissa << 13));
+        }
+        if (exponent == 0) {
+            if (mantissa == 0) {
+                return std::bit_cast<float>(sign);
+            }
+            exponent = 1;
+            while ((mantissa & 0x400) == 0) {
+                mantissa <<= 1;
+                --exponent;
+            }
+            mantissa &= 0x3FF;
+        }
+        return std::bit_cast<float>(sign | (static_cast<uint32_t>(exponent + 112) << 23) |
+                                    (mantissa << 13));
+    }
+
+public:
+    Half() = default;
+    explicit Half(float value) : bits_(FromFloat(value)) {
+    }
+
+    [[nodiscard]] static Half FromBits(uint16_t bits) {
+        Half half;
+        half.bits_ = bits;
+        return half;
+    }
+
+    [[nodiscard]] uint16_t Bits() const {
+        return bits_;
+    }
+
+    explicit operator float() const {
+        return ToFloat(bits_);
+    }
+
+    friend bool operator==(Half lhs, Half rhs) {
+        return lhs.bits_ == rhs.bits_;
+    }
+};
+
+static_assert(sizeof(Half) == sizeof(uint16_t));
+
+}  // namespace util
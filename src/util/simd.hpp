@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DDB_X86 1
+#endif
+
+namespace util {
+
+// Distance kernels over float arrays, AVX2 with FMA is picked at runtime when the CPU has it and
+// the scalar loops are used otherwise. Arrays needn't be aligned
+namespace simd {
+
+[[nodiscard]] inline float ScalarDot(const float* lhs, const float* rhs, size_t count) {
+    float sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+        sum += lhs[i] * rhs[i];
+    }
+    return sum;
+}
+
+[[nodiscard]] inline float ScalarL2(const float* lhs, const float* rhs, size_t count) {
+    float sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+        auto diff = lhs[i] - rhs[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+#ifdef DDB_X86
+[[nodiscard, gnu::target("avx2,fma")]] inline float Sum(__m256 value) {
+    auto sum = _mm_add_ps(_mm256_castps256_ps128(value), _mm256_extractf128_ps(value, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+    return _mm_cvtss_f32(sum);
+}
+
+// Two accumulators hide the latency of FMA
+[[nodiscard, gnu::target("avx2,fma")]] inline float Avx2Dot(const float* lhs, const float* rhs,
+                                                             size_t count) {
+    auto first = _mm256_setzero_ps();
+    auto second = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        first = _mm256_fmadd_ps(_mm256_loadu_ps(lhs + i), _mm256_loadu_ps(rhs + i), first);
+        second =
+            _mm256_fmadd_ps(_mm256_loadu_ps(lhs + i + 8), _mm256_loadu_ps(rhs + i + 8), second);
+    }
+    for (; i + 8 <= count; i += 8) {
+        first = _mm256_fmadd_ps(_mm256_loadu_ps(lhs + i), _mm256_loadu_ps(rhs + i), first);
+    }
+    return Sum(_mm256_add_ps(first, second)) + ScalarDot(lhs + i, rhs + i, count - i);
+}
+
+[[nodiscard, gnu::target("avx2,fma")]] inline float Avx2L2(const float* lhs, const float* rhs,
+                                                            size_t count) {
+    auto first = _mm256_setzero_ps();
+    auto second = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        auto diff = _mm256_sub_ps(_mm256_loadu_ps(lhs + i), _mm256_loadu_ps(rhs + i));
+        first = _mm256_fmadd_ps(diff, diff, first);
+        diff = _mm256_sub_ps(_mm256_loadu_ps(lhs + i + 8), _mm256_loadu_ps(rhs + i + 8));
+        second = _mm256_fmadd_ps(diff, diff, second);
+    }
+    for (; i + 8 <= count; i += 8) {
+        auto diff = _mm256_sub_ps(_mm256_loadu_ps(lhs + i), _mm256_loadu_ps(rhs + i));
+        first = _mm256_fmadd_ps(diff, diff, first);
+    }
+    return Sum(_mm256_add_ps(first, second)) + ScalarL2(lhs + i, rhs + i, count - i);
+}
+#endif
+
+[[nodiscard]] inline bool HasAvx2() {
+#ifdef DDB_X86
+    static const bool kHasAvx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return kHasAvx2;
+#else
+    return false;
+#endif
+}
+
+[[nodiscard]] inline float Dot(const float* lhs, const float* rhs, size_t count) {
+#ifdef DDB_X86
+    if (HasAvx2()) {
+        return Avx2Dot(lhs, rhs, count);
+    }
+#endif
+    return ScalarDot(lhs, rhs, count);
+}
+
+// Squared euclidean distance
+[[nodiscard]] inline float L2(const float* lhs, const float* rhs, size_t count) {
+#ifdef DDB_X86
+    if (HasAvx2()) {
+        return Avx2L2(lhs, rhs, count);
+    }
+#endif
+    return ScalarL2(lhs, rhs, count);
+}
+
+}  // namespace simd
+
+}  // namespace util
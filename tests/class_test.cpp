@@ -1,3 +1,6 @@
+#include <set>
+#include <thread>
+
 #include "test.hpp"
 
 TEST(ClassStorage, ClassAddition) {
@@ -44,4 +47,108 @@ TEST(ClassStorage, ClassRemoval) {
     database.RemoveClass(coordinates_class);
     // database.RemoveClass(city_class);
     database.PrintClasses();
-}
\ No newline at end of file
+}
+TEST(ClassStorage, IdLease) {
+    auto file = util::MakePtr<mem::File>("test.data");
+    auto name = ts::NewClass<ts::StringClass>("name");
+    {
+        auto database = db::Database(file, db::OpenMode::kWrite);
+        database.AddClass(name);
+        for (size_t i = 0; i < 10; ++i) {
+            database.AddNode(ts::New<ts::String>(name, "Greg"));
+        }
+    }
+
+    auto alloc = util::MakePtr<mem::PageAllocator>(file);
+    auto class_storage = util::MakePtr<db::ClassStorage>(alloc);
+    auto header = mem::ClassHeader(class_storage->FindClass(name).value())
+                      .ReadClassHeader(alloc->GetFile());
+
+    std::vector<std::vector<ts::ObjectId>> ids(4);
+    std::vector<std::thread> threads;
+    for (auto& thread_ids : ids) {
+        threads.emplace_back([&class_storage, &header, &thread_ids] {
+            for (size_t i = 0; i < 10000; ++i) {
+                thread_ids.push_back(class_storage->NewNodeId(header));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::set<ts::ObjectId> unique;
+    for (auto& thread_ids : ids) {
+        unique.insert(thread_ids.begin(), thread_ids.end());
+    }
+    ASSERT_EQ(unique.size(), 40000);
+    ASSERT_GE(*unique.begin(), 10);
+    // Only the end of the lease is written
+    ASSERT_GT(header.ReadNodeId(alloc->GetFile()).id_, *unique.rbegin());
+}
+
+TEST(ClassStorage, CatalogSnapshot) {
+    auto file = util::MakePtr<mem::File>("test.data");
+    auto name = ts::NewClass<ts::StringClass>("name");
+    auto point = ts::NewClass<ts::StructClass>("point", ts::NewClass<ts::PrimitiveClass<int>>("x"),
+                                               ts::NewClass<ts::PrimitiveClass<int>>("y"));
+    {
+        auto database = db::Database(file, db::OpenMode::kWrite);
+        database.AddClass(name);
+        database.AddNode(ts::New<ts::String>(name, "Greg"));
+    }
+
+    auto alloc = util::MakePtr<mem::PageAllocator>(file);
+    {
+        auto snapshot = db::CatalogSnapshot(alloc, mem::kCatalogSentinelOffset);
+        auto entries = snapshot.Read(1);
+        ASSERT_TRUE(entries.has_value());
+        ASSERT_EQ(entries->front().fingerprint_, name->GetFingerprint());
+        auto header = mem::ClassHeader(entries->front().index_).ReadClassHeader(file);
+        ASSERT_EQ(entries->front().magic_, header.magic_);
+        ASSERT_EQ(entries->front().id_, header.id_);
+        ASSERT_FALSE(snapshot.Read(2).has_value());
+    }
+    {
+        auto class_storage = db::ClassStorage(alloc);
+        ASSERT_TRUE(class_storage.FindClass(name).has_value());
+        class_storage.AddClass(point);
+        // Headers are changed, so the snapshot isn't trusted until it's rewritten
+        ASSERT_FALSE(db::CatalogSnapshot(alloc, mem::kCatalogSentinelOffset).Read(2).has_value());
+    }
+    ASSERT_TRUE(db::CatalogSnapshot(alloc, mem::kCatalogSentinelOffset).Read(2).has_value());
+
+    auto database = db::Database(file);
+    ASSERT_TRUE(database.Contains(name));
+    ASSERT_TRUE(database.Contains(point));
+}
+
+TEST(ClassStorage, WideClass) {
+    auto file = util::MakePtr<mem::File>("test.data");
+    auto wide = ts::NewClass<ts::StructClass>("document");
+    for (size_t i = 0; i < 800; ++i) {
+        wide->AddField(ts::NewClass<ts::PrimitiveClass<int>>("field" + std::to_string(i)));
+    }
+    ASSERT_GT(ts::ClassObject(wide).Size(), 2 * mem::kDefaultPageSize);
+    {
+        auto database = db::Database(file, db::OpenMode::kWrite);
+        database.AddClass(wide);
+    }
+    {
+        auto database = db::Database(file);
+        ASSERT_TRUE(database.Contains(wide));
+    }
+
+    auto alloc = util::MakePtr<mem::PageAllocator>(file);
+    auto class_storage = db::ClassStorage(alloc);
+    size_t classes = 0;
+    class_storage.VisitClasses([&](ts::Class::Ptr read_class) {
+        ASSERT_EQ(read_class->Serialize(), wide->Serialize());
+        ++classes;
+    });
+    ASSERT_EQ(classes, 1);
+
+    // Header and both overflow pages are freed
+    class_storage.RemoveClass(wide);
+    ASSERT_EQ(file->Read<size_t>(mem::kFreePagesCountOffset), 3);
+}
@@ -2,12 +2,39 @@
 #include <format>
 #include <iterator>
 #include <list>
+#include <random>
 #include <string>
 
 #include "class.hpp"
 #include "object.hpp"
 #include "test.hpp"
 
+struct Office {
+    std::string city;
+    size_t floor;
+};
+DDB_STRUCT(Office, city, floor)
+
+struct Employee {
+    std::string name;
+    int age;
+    Office office;
+};
+DDB_STRUCT(Employee, name, age, office)
+
+struct Point {
+    double x;
+    double y;
+};
+DDB_STRUCT(Point, x, y)
+
+struct Contact_Card {
+    std::string first_name;
+    std::string last_name;
+    long phone_number;
+};
+DDB_STRUCT(Contact_Card, first_name, last_name, phone_number)
+
 TEST(Database, Collect) {
     auto database = util::MakePtr<db::Database>(util::MakePtr<mem::File>("test.data"),
                                                 db::OpenMode::kWrite, CONSOLE_LOGGER);
@@ -57,3 +84,475 @@ TEST(Database, Drop) {
     database->RemoveClass(address_class);
     ASSERT_FALSE(database->Contains(address_class));
 }
+
+TEST(Database, FindNode) {
+    auto file = util::MakePtr<mem::File>("test.data");
+    auto database = db::Database(file, db::OpenMode::kWrite);
+    auto name = ts::NewClass<ts::StringClass>("name");
+    auto value = ts::NewClass<ts::PrimitiveClass<size_t>>("value");
+    auto compact = ts::NewClass<ts::PrimitiveClass<size_t>>("compact");
+    database.AddClass(name);
+    database.AddClass(value);
+    database.AddClass(compact, mem::NodeLayout::kCompact);
+
+    for (size_t i = 0; i < 3000; ++i) {
+        database.AddNode(ts::New<ts::String>(name, std::format("Greg {}", i)));
+        database.AddNode(ts::New<ts::Primitive<size_t>>(value, i));
+        database.AddNode(ts::New<ts::Primitive<size_t>>(compact, i));
+    }
+    database.RemoveNodesIf(name, [](db::VarNodeIterator it) { return it->Id() < 2000; });
+    database.RemoveNodesIf(value, [](db::ValNodeIterator it) { return it->Id() < 2000; });
+    database.RemoveNodesIf(compact, [](db::ValNodeIterator it) { return it->Id() % 2 == 0; });
+    database.Compact();
+
+    ASSERT_FALSE(database.FindNode(name, 1999).has_value());
+    ASSERT_FALSE(database.FindNode(value, 3000).has_value());
+    ASSERT_FALSE(database.FindNode(compact, 2998).has_value());
+    for (size_t id = 2000; id < 3000; ++id) {
+        ASSERT_EQ(database.FindNode(name, id)->Data<ts::String>()->Value(),
+                  std::format("Greg {}", id));
+        ASSERT_EQ(database.FindNode(value, id)->Data<ts::Primitive<size_t>>()->Value(), id);
+    }
+    for (size_t id = 1; id < 3000; id += 2) {
+        ASSERT_EQ(database.FindNode(compact, id)->Data<ts::Primitive<size_t>>()->Value(), id);
+    }
+}
+
+TEST(Database, Stats) {
+    auto file = util::MakePtr<mem::File>("test.data");
+    auto name = ts::NewClass<ts::StringClass>("name");
+    auto value = ts::NewClass<ts::PrimitiveClass<size_t>>("value");
+    {
+        auto database = db::Database(file, db::OpenMode::kWrite);
+        database.AddClass(name);
+        database.AddClass(value, mem::NodeLayout::kCompact);
+        ASSERT_EQ(database.Stats(name).nodes_count_, 0);
+        ASSERT_FALSE(database.Stats(name).min_id_.has_value());
+
+        for (size_t i = 0; i < 3000; ++i) {
+            database.AddNode(ts::New<ts::String>(name, "Greg"));
+            database.AddNode(ts::New<ts::Primitive<size_t>>(value, i));
+        }
+        database.RemoveNodesIf(name, [](db::VarNodeIterator it) {
+            return it->Id() < 1000 || it->Id() == 2999;
+        });
+        database.RemoveNodesIf(value, [](db::ValNodeIterator it) { return it->Id() % 2 == 0; });
+    }
+
+    auto database = db::Database(file, db::OpenMode::kRead);
+    auto names = database.Stats(name);
+    ASSERT_EQ(names.nodes_count_, 1999);
+    ASSERT_EQ(names.min_id_, 1000);
+    ASSERT_EQ(names.max_id_, 2998);
+    ASSERT_GT(names.pages_count_, 0);
+
+    size_t bytes = 0;
+    database.VisitNodes(name, db::kAll, [&bytes](db::VarNodeIterator it) { bytes += it->Size(); });
+    ASSERT_EQ(names.live_bytes_, bytes);
+
+    auto values = database.Stats(value);
+    ASSERT_EQ(values.nodes_count_, 1500);
+    ASSERT_EQ(values.live_bytes_, 1500 * sizeof(size_t));
+    ASSERT_EQ(values.min_id_, 1);
+}
+
+TEST(Database, Analyze) {
+    auto file = util::MakePtr<mem::File>("test.data");
+    auto person = ts::NewClass<ts::StructClass>("person", ts::NewClass<ts::StringClass>("name"),
+                                                ts::NewClass<ts::PrimitiveClass<int>>("age"));
+    auto knows = ts::NewClass<ts::RelationClass>("knows", person, person);
+    {
+        auto database = db::Database(file, db::OpenMode::kWrite);
+        database.AddClass(person);
+        database.AddClass(knows);
+        for (int i = 0; i < 5000; ++i) {
+            auto name = "Greg " + std::to_string(i % 50);
+            database.AddNode(ts::New<ts::Struct>(person, name, i % 100));
+            // First person knows everybody, the others know only one
+            database.AddNode(ts::New<ts::Relation>(knows, ID(i % 2 == 0 ? 0 : i), ID(i)));
+        }
+        ASSERT_FALSE(database.GetAnalysis(person).has_value());
+
+        auto analysis = database.Analyze(person);
+        auto& age = analysis.GetColumn("age");
+        ASSERT_EQ(age.values_count_, 5000);
+        ASSERT_NEAR(age.distinct_, 100, 10);
+        ASSERT_NEAR(age.EstimateLess(50.), 0.5, 0.1);
+        ASSERT_NEAR(age.EstimateEqual(10.), 0.01, 0.002);
+        ASSERT_EQ(age.EstimateEqual(200.), 0);
+        ASSERT_NEAR(analysis.GetColumn("name").distinct_, 50, 5);
+
+        database.Analyze(knows);
+    }
+
+    auto database = db::Database(file, db::OpenMode::kRead);
+    auto analysis = database.GetAnalysis(person);
+    ASSERT_TRUE(analysis.has_value());
+    ASSERT_NEAR(analysis->GetColumn("age").distinct_, 100, 10);
+    ASSERT_EQ(std::get<std::string>(analysis->GetColumn("name").bounds_.front()), "Greg 0");
+
+    auto degrees = database.GetAnalysis(knows)->GetColumn("out_degree");
+    ASSERT_NEAR(degrees.distinct_, 2, 0.5);
+    ASSERT_EQ(std::get<double>(degrees.bounds_.back()), 2500);
+}
+
+TEST(Database, BoundStruct) {
+    static_assert(ts::FixedSize<Point>() == 2 * sizeof(double));
+    static_assert(!ts::FixedSize<Employee>().has_value());
+    ASSERT_EQ(ts::ClassOf<Employee>()->Serialize(),
+              ts::NewClass<ts::StructClass>(
+                  "Employee", ts::NewClass<ts::StringClass>("name"),
+                  ts::NewClass<ts::PrimitiveClass<int>>("age"),
+                  ts::NewClass<ts::StructClass>("office", ts::NewClass<ts::StringClass>("city"),
+                                                ts::NewClass<ts::PrimitiveClass<size_t>>("floor")))
+                  ->Serialize());
+
+    auto file = util::MakePtr<mem::File>("test.data");
+    {
+        auto database = db::Database(file, db::OpenMode::kWrite);
+        database.AddClass(ts::ClassOf<Employee>());
+        database.AddClass(ts::ClassOf<Point>());
+        for (int i = 0; i < 1000; ++i) {
+            database.Insert(Employee{"Greg " + std::to_string(i), i, Office{"Moscow", 5ul}});
+            database.Insert(Point{1. * i, -1. * i});
+        }
+    }
+
+    auto database = db::Database(file, db::OpenMode::kRead);
+    int count = 0;
+    database.Visit<Employee>([&count](const Employee& employee) {
+        ASSERT_EQ(employee.name, "Greg " + std::to_string(employee.age));
+        ASSERT_EQ(employee.office.city, "Moscow");
+        ASSERT_EQ(employee.office.floor, 5);
+        ++count;
+    });
+    ASSERT_EQ(count, 1000);
+
+    // Nodes written through the binding are read by the objects as well
+    double sum = 0;
+    database.VisitNodes(ts::ClassOf<Point>(), db::kAll, [&sum](db::ValNodeIterator it) {
+        auto point = it->Data<ts::Struct>();
+        sum += point->GetField<ts::Primitive<double>>("x")->Value() +
+               point->GetField<ts::Primitive<double>>("y")->Value();
+    });
+    ASSERT_EQ(sum, 0);
+}
+
+TEST(Database, BoundNames) {
+    // Underscores of the identifiers aren't allowed in the class names
+    ASSERT_EQ(ts::ClassOf<Contact_Card>()->Name(), "Contact-Card");
+    ASSERT_EQ(ts::ClassOf<Contact_Card>()->GetLayout().Find("first-name"), 0);
+
+    auto file = util::MakePtr<mem::File>("test.data");
+    // Structs with strings are read from the file field by field
+    auto card = ts::BoundObject<Contact_Card>(Contact_Card{"Gregory", "", 42});
+    std::ignore = card.Write(file, 0);
+    auto read = ts::BoundObject<Contact_Card>(Contact_Card{});
+    read.Read(file, 0);
+    ASSERT_EQ(read.Value().first_name, "Gregory");
+    ASSERT_EQ(read.Value().last_name, "");
+    ASSERT_EQ(read.Value().phone_number, 42);
+
+    {
+        auto database = db::Database(file, db::OpenMode::kWrite);
+        database.AddClass(ts::ClassOf<Contact_Card>());
+        database.Insert(Contact_Card{"Greg", "", 88005553535});
+    }
+    auto database = db::Database(file, db::OpenMode::kRead);
+    size_t count = 0;
+    database.Visit<Contact_Card>([&count](const Contact_Card& contact) {
+        ASSERT_EQ(contact.first_name, "Greg");
+        ASSERT_EQ(contact.phone_number, 88005553535);
+        ++count;
+    });
+    ASSERT_EQ(count, 1);
+}
+
+TEST(Database, NearestNeighbors) {
+    constexpr size_t kDimension = 37;
+    std::vector<float> lhs(kDimension);
+    std::vector<float> rhs(kDimension);
+    for (size_t i = 0; i < kDimension; ++i) {
+        lhs[i] = static_cast<float>(i % 7) - 3.f;
+        rhs[i] = static_cast<float>(i % 5) * 0.5f;
+    }
+    ASSERT_FLOAT_EQ(util::simd::Dot(lhs.data(), rhs.data(), kDimension),
+                    util::simd::ScalarDot(lhs.data(), rhs.data(), kDimension));
+    ASSERT_FLOAT_EQ(util::simd::L2(lhs.data(), rhs.data(), kDimension),
+                    util::simd::ScalarL2(lhs.data(), rhs.data(), kDimension));
+
+    auto document =
+        ts::NewClass<ts::StructClass>("document", ts::NewClass<ts::PrimitiveClass<int>>("rank"),
+                                      ts::NewVectorClass<float, 3>("embedding"));
+    auto database = db::Database(util::MakePtr<mem::File>("test.data"), db::OpenMode::kWrite);
+    database.AddClass(document);
+    for (int i = 0; i < 1000; ++i) {
+        auto x = static_cast<float>(i);
+        database.AddNode(ts::New<ts::Struct>(document, i, std::array{x, 1.f, 0.f}));
+    }
+
+    auto query = std::array{500.2f, 1.f, 0.f};
+    auto neighbors = database.NearestNeighbors(document, "embedding", query, 3);
+    ASSERT_EQ(neighbors.size(), 3);
+    ASSERT_EQ(neighbors[0].id_, 500);
+    ASSERT_EQ(neighbors[1].id_, 501);
+    ASSERT_EQ(neighbors[2].id_, 499);
+    ASSERT_LE(neighbors[0].distance_, neighbors[1].distance_);
+
+    auto largest = database.NearestNeighbors(document, "embedding", query, 1,
+                                             db::Metric::kInnerProduct);
+    ASSERT_EQ(largest.front().id_, 999);
+
+    auto cosine = database.NearestNeighbors(document, "embedding", std::array{0.f, 1.f, 0.f}, 1,
+                                            db::Metric::kCosine);
+    ASSERT_EQ(cosine.front().id_, 0);
+    ASSERT_NEAR(cosine.front().distance_, 0, 1e-6);
+
+    db::IdBitmap odd(1000);
+    for (size_t id = 1; id < odd.size(); id += 2) {
+        odd[id] = true;
+    }
+    auto filtered =
+        database.NearestNeighbors(document, "embedding", query, 2, db::Metric::kL2, &odd);
+    ASSERT_EQ(filtered[0].id_, 501);
+    ASSERT_EQ(filtered[1].id_, 499);
+
+    ASSERT_THROW(std::ignore = database.NearestNeighbors(document, "rank", query, 1),
+                 error::TypeError);
+    ASSERT_THROW(std::ignore = database.NearestNeighbors(document, "embedding",
+                                                         std::array{1.f}, 1),
+                 error::BadArgument);
+}
+
+TEST(Database, VectorIndex) {
+    constexpr size_t kDimension = 8;
+    constexpr size_t kCount = 1000;
+    constexpr size_t kNeighbors = 10;
+    auto item = ts::NewClass<ts::StructClass>("item", ts::NewClass<ts::PrimitiveClass<int>>("rank"),
+                                              ts::NewVectorClass<float, kDimension>("embedding"));
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+    auto random_vector = [&] {
+        std::array<float, kDimension> vector;
+        for (auto& value : vector) {
+            value = uniform(generator);
+        }
+        return vector;
+    };
+    std::vector<std::array<float, kDimension>> queries(20);
+    for (auto& query : queries) {
+        query = random_vector();
+    }
+
+    auto file = util::MakePtr<mem::File>("test.data");
+    {
+        auto database = db::Database(file, db::OpenMode::kWrite);
+        database.AddClass(item);
+        for (size_t i = 0; i < kCount / 2; ++i) {
+            database.AddNode(ts::New<ts::Struct>(item, static_cast<int>(i), random_vector()));
+        }
+        // First half is indexed by the build, the rest by the insertions
+        database.CreateVectorIndex(item, "embedding", db::HnswParams{8, 64, 32});
+        ASSERT_THROW(database.CreateVectorIndex(item, "embedding"), error::BadArgument);
+        for (size_t i = kCount / 2; i < kCount; ++i) {
+            database.AddNode(ts::New<ts::Struct>(item, static_cast<int>(i), random_vector()));
+        }
+        database.RemoveNodesIf(item, [](db::ValNodeIterator it) { return it->Id() % 10 == 0; });
+    }
+    {
+        // Pages of the graph are read once by the index object instead of once per distance
+        auto alloc = util::MakePtr<mem::PageAllocator>(file);
+        auto class_storage = db::ClassStorage(alloc);
+        auto header = mem::ClassHeader(class_storage.FindClass(item).value());
+        auto index = db::HnswIndex(alloc, header.GetVectorIndexSentinelOffset(file));
+        // Graph takes about 35 pages: 1000 nodes of 128 bytes and the upper links
+        for (auto& query : queries) {
+            std::ignore = index.Search(query, kNeighbors);
+        }
+        ASSERT_LE(index.PagesRead(), 40);
+    }
+
+    auto database = db::Database(file, db::OpenMode::kRead);
+    size_t hits = 0;
+    for (auto& query : queries) {
+        auto exact = database.NearestNeighbors(item, "embedding", query, kNeighbors);
+        auto approximate = database.ApproximateNeighbors(item, query, kNeighbors);
+        ASSERT_EQ(approximate.size(), kNeighbors);
+        for (auto& neighbor : approximate) {
+            ASSERT_NE(neighbor.id_ % 10, 0);
+            hits += std::count_if(exact.begin(), exact.end(), [&](const db::Neighbor& other) {
+                return other.id_ == neighbor.id_;
+            });
+        }
+    }
+    ASSERT_GE(static_cast<double>(hits) / (queries.size() * kNeighbors), 0.95);
+
+    database.SetVectorIndexEfSearch(item, 1);
+    ASSERT_EQ(database.ApproximateNeighbors(item, queries[0], kNeighbors).size(), kNeighbors);
+    ASSERT_THROW(std::ignore = database.ApproximateNeighbors(item, std::array{1.f}, 1),
+                 error::BadArgument);
+
+    database.DropVectorIndex(item);
+    ASSERT_THROW(std::ignore = database.ApproximateNeighbors(item, queries[0], 1),
+                 error::BadArgument);
+}
+
+TEST(Database, VectorIndexClusters) {
+    constexpr size_t kDimension = 16;
+    constexpr size_t kCount = 2000;
+    constexpr size_t kNeighbors = 10;
+    auto item = ts::NewClass<ts::StructClass>("item", ts::NewClass<ts::PrimitiveClass<int>>("rank"),
+                                              ts::NewVectorClass<float, kDimension>("embedding"));
+    std::mt19937 generator(11);
+    std::normal_distribution<float> normal(0.f, 1.f);
+    std::vector<std::array<float, kDimension>> centers(32);
+    for (auto& center : centers) {
+        for (auto& value : center) {
+            value = 4 * normal(generator);
+        }
+    }
+    auto random_vector = [&] {
+        auto vector = centers[generator() % centers.size()];
+        for (auto& value : vector) {
+            value += normal(generator);
+        }
+        return vector;
+    };
+
+    auto file = util::MakePtr<mem::File>("test.data");
+    auto database = db::Database(file, db::OpenMode::kWrite);
+    database.AddClass(item);
+    database.CreateVectorIndex(item, "embedding", db::HnswParams{8, 64, 32});
+    for (size_t i = 0; i < kCount; ++i) {
+        database.AddNode(ts::New<ts::Struct>(item, static_cast<int>(i), random_vector()));
+    }
+
+    // Closest links lead into the own cluster only, the selected ones keep the clusters connected
+    size_t hits = 0;
+    for (size_t i = 0; i < 50; ++i) {
+        auto query = random_vector();
+        auto exact = database.NearestNeighbors(item, "embedding", query, kNeighbors);
+        auto approximate = database.ApproximateNeighbors(item, query, kNeighbors);
+        ASSERT_EQ(approximate.size(), kNeighbors);
+        for (auto& neighbor : approximate) {
+            hits += std::count_if(exact.begin(), exact.end(), [&](const db::Neighbor& other) {
+                return other.id_ == neighbor.id_;
+            });
+        }
+    }
+    ASSERT_GE(static_cast<double>(hits) / (50 * kNeighbors), 0.95);
+}
+
+TEST(Database, QuantizedIndex) {
+    constexpr size_t kDimension = 16;
+    constexpr size_t kCount = 2000;
+    constexpr size_t kNeighbors = 10;
+    auto item = ts::NewClass<ts::StructClass>("item", ts::NewClass<ts::PrimitiveClass<int>>("rank"),
+                                              ts::NewVectorClass<float, kDimension>("embedding"));
+    std::mt19937 generator(7);
+    std::normal_distribution<float> normal(0.f, 1.f);
+    std::vector<std::array<float, kDimension>> centers(32);
+    for (auto& center : centers) {
+        for (auto& value : center) {
+            value = 4 * normal(generator);
+        }
+    }
+    auto random_vector = [&] {
+        auto vector = centers[generator() % centers.size()];
+        for (auto& value : vector) {
+            value += normal(generator);
+        }
+        return vector;
+    };
+
+    auto file = util::MakePtr<mem::File>("test.data");
+    {
+        auto database = db::Database(file, db::OpenMode::kWrite);
+        database.AddClass(item);
+        for (size_t i = 0; i < kCount; ++i) {
+            database.AddNode(ts::New<ts::Struct>(item, static_cast<int>(i), random_vector()));
+        }
+        ASSERT_THROW(database.CreateQuantizedIndex(item, "embedding", db::IvfPqParams{16, 5}),
+                     error::BadArgument);
+        database.CreateQuantizedIndex(item, "embedding", db::IvfPqParams{16, 4, 4, 1000, 8});
+        for (size_t i = kCount; i < kCount + 100; ++i) {
+            database.AddNode(ts::New<ts::Struct>(item, static_cast<int>(i), random_vector()));
+        }
+        database.RemoveNodesIf(item, [](db::ValNodeIterator it) { return it->Id() % 10 == 0; });
+    }
+
+    auto database = db::Database(file, db::OpenMode::kRead);
+    size_t hits = 0;
+    for (size_t i = 0; i < 50; ++i) {
+        auto query = random_vector();
+        auto exact = database.NearestNeighbors(item, "embedding", query, 1);
+        auto approximate = database.QuantizedNeighbors(item, query, kNeighbors);
+        ASSERT_EQ(approximate.size(), kNeighbors);
+        for (auto& neighbor : approximate) {
+            ASSERT_NE(neighbor.id_ % 10, 0);
+            hits += neighbor.id_ == exact.front().id_;
+        }
+    }
+    ASSERT_GE(hits, 45);
+
+    auto all_lists = database.QuantizedNeighbors(item, centers[0], 1, 16);
+    ASSERT_EQ(all_lists.size(), 1);
+    ASSERT_THROW(std::ignore = database.QuantizedNeighbors(item, std::array{1.f}, 1),
+                 error::BadArgument);
+
+    database.DropQuantizedIndex(item);
+    ASSERT_THROW(std::ignore = database.QuantizedNeighbors(item, centers[0], 1),
+                 error::BadArgument);
+}
+
+TEST(Database, QuantizedIndexCompaction) {
+    constexpr size_t kCount = 1000;
+    auto item = ts::NewClass<ts::StructClass>("item", ts::NewClass<ts::PrimitiveClass<int>>("rank"),
+                                              ts::NewVectorClass<float, 8>("embedding"));
+    std::mt19937 generator(3);
+    std::normal_distribution<float> normal(0.f, 1.f);
+    auto random_vector = [&] {
+        std::array<float, 8> vector;
+        for (auto& value : vector) {
+            value = normal(generator);
+        }
+        return vector;
+    };
+
+    auto file = util::MakePtr<mem::File>("test.data");
+    {
+        auto database = db::Database(file, db::OpenMode::kWrite);
+        database.AddClass(item);
+        for (size_t i = 0; i < kCount; ++i) {
+            database.AddNode(ts::New<ts::Struct>(item, static_cast<int>(i), random_vector()));
+        }
+        database.CreateQuantizedIndex(item, "embedding", db::IvfPqParams{4, 2, 4, kCount, 4});
+    }
+
+    auto alloc = util::MakePtr<mem::PageAllocator>(file);
+    auto class_storage = db::ClassStorage(alloc);
+    auto header = mem::ClassHeader(class_storage.FindClass(item).value());
+    auto index = db::IvfPqIndex(alloc, header.GetQuantizedIndexSentinelOffset(file));
+    std::vector<ts::ObjectId> removed;
+    for (ts::ObjectId id = 0; id < kCount; id += 10) {
+        removed.push_back(id);
+    }
+    index.Remove(removed);
+    ASSERT_EQ(index.Tombstones(), kCount / 10);
+
+    // Lists are rewritten when a quarter of their entries are removed
+    removed.clear();
+    for (ts::ObjectId id = 0; id < kCount; ++id) {
+        if (id % 10 != 0 && id % 10 < 4) {
+            removed.push_back(id);
+        }
+    }
+    index.Remove(removed);
+    ASSERT_EQ(index.Tombstones(), 0);
+    size_t found = 0;
+    for (auto& neighbor : index.Search(random_vector(), kCount, 4)) {
+        ASSERT_GE(neighbor.id_ % 10, 4);
+        ++found;
+    }
+    ASSERT_EQ(found, kCount * 6 / 10);
+}
@@ -42,4 +42,127 @@ TEST(Node, NodeVarious) {
     std::cerr << meta_string.ToString() << std::endl;
     std::cerr << meta_string_free.ToString() << std::endl;
     std::cerr << meta_string_ivalid.ToString() << std::endl;
-}
\ No newline at end of file
+}
+TEST(Node, SingleBuffer) {
+    auto file = util::MakePtr<mem::File>("test.data");
+    file->Clear();
+    auto person = ts::NewClass<ts::StructClass>(
+        "person", ts::NewClass<ts::StringClass>("name"),
+        ts::NewClass<ts::PrimitiveClass<int>>("age"),
+        ts::NewClass<ts::StructClass>("address", ts::NewClass<ts::StringClass>("city"),
+                                      ts::NewClass<ts::PrimitiveClass<size_t>>("house")));
+    auto node = db::Node(mem::kMagic, 7, ts::New<ts::Struct>(person, "Greg", 30, "Moscow", 5ul));
+    node.Write(file, 0);
+
+    std::vector<char> buffer(node.Size());
+    ASSERT_EQ(node.Write(buffer.data()), node.Size());
+    ASSERT_EQ(file->ReadVector<char>(0, buffer.size()), buffer);
+
+    auto from_file = db::Node(mem::kMagic, person, file, 0);
+    auto from_buffer =
+        db::Node(mem::kMagic, person, file, std::string_view(buffer.data(), buffer.size()));
+    ASSERT_EQ(from_file.ToString(), node.ToString());
+    ASSERT_EQ(from_buffer.ToString(), node.ToString());
+}
+
+TEST(Node, View) {
+    auto file = util::MakePtr<mem::File>("test.data");
+    auto database = db::Database(file, db::OpenMode::kWrite);
+    auto point = ts::NewClass<ts::StructClass>("point", ts::NewClass<ts::PrimitiveClass<int>>("x"),
+                                               ts::NewClass<ts::PrimitiveClass<double>>("y"));
+    auto person = ts::NewClass<ts::StructClass>(
+        "person", ts::NewClass<ts::StringClass>("name"),
+        ts::NewClass<ts::PrimitiveClass<int>>("age"),
+        ts::NewClass<ts::StructClass>("address", ts::NewClass<ts::StringClass>("city"),
+                                      ts::NewClass<ts::PrimitiveClass<size_t>>("house")));
+    database.AddClass(point);
+    database.AddClass(person);
+    auto big_name = std::string(mem::kDefaultPageSize, 'G');
+    for (int i = 0; i < 1000; ++i) {
+        database.AddNode(ts::New<ts::Struct>(point, i, i / 2.));
+        database.AddNode(ts::New<ts::Struct>(person, i == 500 ? big_name : "Greg", i,
+                                             "Saint-Petersburg", static_cast<size_t>(i)));
+    }
+
+    int x_sum = 0;
+    database.VisitNodes(point, db::kAll, [&x_sum](db::ValNodeIterator it) {
+        auto view = it.View();
+        ASSERT_EQ(view.Get<double>("y"), view.Get<int>("x") / 2.);
+        ASSERT_THROW(std::ignore = view.Get<int>("y"), error::TypeError);
+        ASSERT_THROW(std::ignore = view.Get<int>("z"), error::BadArgument);
+        x_sum += view.Get<int>("x");
+    });
+    ASSERT_EQ(x_sum, 999 * 1000 / 2);
+
+    size_t count = 0;
+    database.VisitNodes(person, db::kAll, [&count](db::VarNodeIterator it) {
+        auto view = it.View();
+        auto age = view.Get<int>("age");
+        ASSERT_EQ(view.GetString("name").size(), age == 500 ? mem::kDefaultPageSize : 4);
+        ASSERT_EQ(view.GetString("address.city"), "Saint-Petersburg");
+        ASSERT_EQ(view.Get<size_t>("address.house"), static_cast<size_t>(age));
+        ASSERT_EQ(view.Id(), it->Id());
+        ++count;
+    });
+    ASSERT_EQ(count, 1000);
+}
+
+TEST(Node, VectorView) {
+    auto file = util::MakePtr<mem::File>("test.data");
+    auto database = db::Database(file, db::OpenMode::kWrite);
+    auto embedding = ts::NewVectorClass<float, 16>("embedding");
+    database.AddClass(embedding);
+    for (int i = 0; i < 1000; ++i) {
+        auto values = std::vector<float>(16, static_cast<float>(i));
+        database.AddNode(ts::New<ts::Vector<float>>(embedding, values));
+    }
+
+    float sum = 0;
+    database.VisitNodes(embedding, db::kAll, [&sum](db::ValNodeIterator it) {
+        auto values = it.View().GetVector<float>();
+        ASSERT_EQ(values.size(), 16);
+        ASSERT_EQ(values.front(), values.back());
+        ASSERT_THROW(std::ignore = it.View().GetVector<int8_t>(), error::TypeError);
+        sum += values.front();
+    });
+    ASSERT_EQ(sum, 999 * 1000 / 2);
+}
+
+TEST(Node, MisalignedVectorView) {
+    auto file = util::MakePtr<mem::File>("test.data");
+    auto database = db::Database(file, db::OpenMode::kWrite);
+    auto document = ts::NewClass<ts::StructClass>("document",
+                                                  ts::NewClass<ts::PrimitiveClass<char>>("flag"),
+                                                  ts::NewVectorClass<float, 4>("embedding"));
+    auto titled = ts::NewClass<ts::StructClass>("titled", ts::NewClass<ts::StringClass>("title"),
+                                                ts::NewVectorClass<float, 4>("embedding"));
+    database.AddClass(document);
+    database.AddClass(titled);
+    for (int i = 0; i < 100; ++i) {
+        auto value = static_cast<float>(i);
+        database.AddNode(
+            ts::New<ts::Struct>(document, 'a', std::array{value, value, value, value}));
+        database.AddNode(ts::New<ts::Struct>(titled, std::string(i % 7, 't'),
+                                             std::array{value, value, value, value}));
+    }
+
+    // Vectors after the odd sized fields are copied, the spans of the page stay valid together
+    for (auto& node_class : {document, titled}) {
+        float sum = 0;
+        auto check = [&sum](auto it) {
+            auto view = it.View();
+            auto values = view.template GetVector<float>("embedding");
+            auto again = view.template GetVector<float>("embedding");
+            ASSERT_EQ(values.size(), 4);
+            ASSERT_EQ(values.front(), values.back());
+            ASSERT_TRUE(std::ranges::equal(values, again));
+            sum += values.front();
+        };
+        if (node_class == document) {
+            database.VisitNodes(node_class, db::kAll, [&](db::ValNodeIterator it) { check(it); });
+        } else {
+            database.VisitNodes(node_class, db::kAll, [&](db::VarNodeIterator it) { check(it); });
+        }
+        ASSERT_EQ(sum, 99 * 100 / 2);
+    }
+}
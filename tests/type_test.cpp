@@ -119,3 +119,215 @@ TEST(TypeSystem, Metadata) {
     ASSERT_FALSE(ts::ClassObject(person_class)
                      .Contains<ts::StringClass>(ts::NewClass<ts::StringClass>("address")));
 }
+
+TEST(TypeSystem, Layout) {
+    auto address = ts::NewClass<ts::StructClass>("address", ts::NewClass<ts::StringClass>("city"),
+                                                 ts::NewClass<ts::PrimitiveClass<size_t>>("house"));
+    auto person = ts::NewClass<ts::StructClass>(
+        "person", ts::NewClass<ts::PrimitiveClass<int>>("age"),
+        ts::NewClass<ts::StringClass>("name"), address,
+        ts::NewClass<ts::PrimitiveClass<double>>("height"));
+    auto& layout = person->GetLayout();
+    ASSERT_FALSE(person->Size().has_value());
+
+    auto greg = ts::New<ts::Struct>(person, 20, "Greg", "Saint-Petersburg",
+                                    static_cast<size_t>(28), 1.8);
+    std::string record(greg->Size(), '\0');
+    greg->Write(record.data());
+
+    auto offset = [&](std::string_view path) {
+        return layout.GetOffset(layout.Find(path).value(), record);
+    };
+    ASSERT_EQ(offset("age"), 0);
+    ASSERT_EQ(offset("name"), sizeof(int));
+    ASSERT_EQ(offset("address"), offset("address.city"));
+    ASSERT_EQ(offset("address.city"), sizeof(int) + sizeof(uint32_t) + 4);
+    ASSERT_EQ(offset("address.house"), offset("address.city") + sizeof(uint32_t) + 16);
+    ASSERT_EQ(offset("height"), offset("address.house") + sizeof(size_t));
+    ASSERT_FALSE(layout.Find("house").has_value());
+
+    ASSERT_EQ(greg->GetField<ts::Primitive<double>>("height")->Value(), 1.8);
+    ASSERT_EQ(greg->GetField<ts::Struct>("address")->GetField<ts::String>("city")->Value(),
+              "Saint-Petersburg");
+    ASSERT_EQ(address->Size(), std::nullopt);
+    auto point = ts::NewClass<ts::StructClass>("point", ts::NewClass<ts::PrimitiveClass<int>>("x"),
+                                               ts::NewClass<ts::PrimitiveClass<int>>("y"));
+    ASSERT_EQ(point->Size(), 2 * sizeof(int));
+}
+
+TEST(TypeSystem, RelationLayout) {
+    auto name = ts::NewClass<ts::StringClass>("name");
+    auto note = ts::NewClass<ts::StructClass>("note", ts::NewClass<ts::StringClass>("text"),
+                                              ts::NewClass<ts::PrimitiveClass<int>>("weight"));
+    auto knows = ts::NewClass<ts::RelationClass>("knows", name, name, note);
+    auto score = ts::NewClass<ts::PrimitiveClass<double>>("score");
+    auto record_class = ts::NewClass<ts::StructClass>("record", knows, score);
+    auto& layout = record_class->GetLayout();
+
+    auto record_object = util::MakePtr<ts::Struct>(record_class);
+    record_object->AddFieldValue(
+        util::MakePtr<ts::Relation>(knows, 1, 2, ts::New<ts::Struct>(note, "likes", 3)));
+    record_object->AddFieldValue(ts::New<ts::Primitive<double>>(score, 0.5));
+    std::string record(record_object->Size(), '\0');
+    record_object->Write(record.data());
+
+    auto offset = [&](std::string_view path) {
+        return layout.GetOffset(layout.Find(path).value(), record);
+    };
+    ASSERT_EQ(offset("knows"), 0);
+    ASSERT_EQ(offset("knows.note.text"), 2 * sizeof(ts::Id));
+    ASSERT_EQ(offset("knows.note.weight"), offset("knows.note.text") + sizeof(uint32_t) + 5);
+    ASSERT_EQ(offset("score"), record.size() - sizeof(double));
+}
+
+TEST(TypeSystem, FrozenClass) {
+    auto point = ts::NewClass<ts::StructClass>("point", ts::NewClass<ts::PrimitiveClass<int>>("x"));
+    auto segment = ts::NewClass<ts::StructClass>("segment", point, point);
+    ASSERT_EQ(segment->Size(), 2 * sizeof(int));
+
+    // Layout and fingerprint of the segment are built of the point, so the point is kept as it is
+    ASSERT_TRUE(point->IsFrozen());
+    ASSERT_THROW(point->AddField(ts::NewClass<ts::PrimitiveClass<int>>("y")), error::TypeError);
+    ASSERT_EQ(point->Size(), sizeof(int));
+    segment->AddField(ts::NewClass<ts::PrimitiveClass<int>>("width"));
+    ASSERT_EQ(segment->Size(), 3 * sizeof(int));
+
+    auto located = ts::NewClass<ts::RelationClass>("located", ts::NewClass<ts::StringClass>("name"),
+                                                   segment);
+    ASSERT_THROW(segment->AddField(ts::NewClass<ts::PrimitiveClass<int>>("height")),
+                 error::TypeError);
+    ASSERT_EQ(located->Size(), 2 * sizeof(ts::Id));
+}
+
+TEST(TypeSystem, Kinds) {
+    auto point = ts::NewClass<ts::StructClass>("point", ts::NewClass<ts::PrimitiveClass<int>>("x"),
+                                               ts::NewClass<ts::PrimitiveClass<double>>("y"));
+    auto name = ts::NewClass<ts::StringClass>("name");
+    auto relation = ts::NewClass<ts::RelationClass>("located", name, point);
+    ASSERT_EQ(point->GetKind(), ts::kStructKind);
+    ASSERT_EQ(name->GetKind(), ts::kStringKind);
+    ASSERT_EQ(relation->GetKind(), ts::kRelationKind);
+    ASSERT_EQ(point->GetFields()[1]->GetKind(), ts::PrimitiveKind<double>());
+    ASSERT_EQ(ts::PrimitiveKind<size_t>(), ts::PrimitiveKind<unsigned long>());
+    ASSERT_NE(ts::PrimitiveKind<int>(), ts::PrimitiveKind<unsigned int>());
+
+    auto object = ts::DefaultNewObject(point);
+    ASSERT_TRUE(util::Is<ts::Primitive<double>>(util::As<ts::Struct>(object)->GetFields()[1]));
+    ASSERT_TRUE(util::Is<ts::Relation>(ts::DefaultNewObject(relation)));
+    ASSERT_THROW(ts::VisitPrimitive(name->GetKind(), [](auto) {}), error::TypeError);
+}
+
+TEST(TypeSystem, TypedNew) {
+    auto person = ts::NewClass<ts::StructClass>(
+        "person", ts::NewClass<ts::StringClass>("name"),
+        ts::NewClass<ts::PrimitiveClass<int>>("age"),
+        ts::NewClass<ts::StructClass>("address", ts::NewClass<ts::StringClass>("city"),
+                                      ts::NewClass<ts::PrimitiveClass<double>>("latitude")));
+    std::string name = "Greg";
+    std::string_view city = "Saint-Petersburg";
+    auto greg = ts::New<ts::Struct>(person, name, 20, city, 59.9);
+    ASSERT_EQ(greg->GetField<ts::String>("name")->Value(), "Greg");
+    ASSERT_EQ(greg->GetField<ts::Primitive<int>>("age")->Value(), 20);
+    ASSERT_EQ(greg->GetField<ts::Struct>("address")->GetField<ts::String>("city")->Value(), city);
+
+    ASSERT_THROW(std::ignore = ts::New<ts::Struct>(person, "Greg", 20., city, 59.9),
+                 error::TypeError);
+    ASSERT_THROW(std::ignore = ts::New<ts::Struct>(person, 20, "Greg", city, 59.9),
+                 error::TypeError);
+    ASSERT_THROW(std::ignore = ts::New<ts::Struct>(person, "Greg", 20), error::BadArgument);
+}
+
+TEST(TypeSystem, Arena) {
+    auto person = ts::NewClass<ts::StructClass>(
+        "person", ts::NewClass<ts::StringClass>("name"),
+        ts::NewClass<ts::PrimitiveClass<int>>("age"),
+        ts::NewClass<ts::StructClass>("address", ts::NewClass<ts::StringClass>("city"),
+                                      ts::NewClass<ts::PrimitiveClass<size_t>>("house")));
+    auto greg = ts::New<ts::Struct>(person, "Greg", 20, "Saint-Petersburg", 28ul);
+    std::string record(greg->Size(), '\0');
+    greg->Write(record.data());
+
+    auto default_resource = util::CurrentResource();
+    {
+        util::Arena arena;
+        ASSERT_EQ(util::CurrentResource(), arena.Resource());
+        for (int i = 0; i < 1000; ++i) {
+            auto object = util::As<ts::Struct>(ts::DefaultNewObject(person));
+            ASSERT_EQ(object->GetFields().get_allocator().resource(), arena.Resource());
+            object->Read(record.data());
+            ASSERT_EQ(object->ToString(), greg->ToString());
+        }
+        {
+            util::Arena nested;
+            ASSERT_EQ(util::CurrentResource(), nested.Resource());
+        }
+        ASSERT_EQ(util::CurrentResource(), arena.Resource());
+    }
+    ASSERT_EQ(util::CurrentResource(), default_resource);
+    ASSERT_EQ(greg->GetFields().get_allocator().resource(), default_resource);
+}
+
+TEST(TypeSystem, Catalog) {
+    auto make_person = [](std::string age_name) {
+        return ts::NewClass<ts::StructClass>(
+            "person", ts::NewClass<ts::StringClass>("name"),
+            ts::NewClass<ts::PrimitiveClass<int>>(std::move(age_name)),
+            ts::NewClass<ts::StructClass>("address", ts::NewClass<ts::StringClass>("city"),
+                                          ts::NewClass<ts::PrimitiveClass<size_t>>("house")));
+    };
+    auto person = make_person("age");
+    auto knows = ts::NewClass<ts::RelationClass>("knows", person, person,
+                                                 ts::NewClass<ts::PrimitiveClass<double>>("since"));
+    ASSERT_EQ(person->GetFingerprint(), make_person("age")->GetFingerprint());
+    ASSERT_NE(person->GetFingerprint(), make_person("years")->GetFingerprint());
+    ASSERT_NE(person->GetFingerprint(), knows->GetFingerprint());
+
+    auto file = util::MakePtr<mem::File>("test.data");
+    file->Clear();
+    auto holder = ts::ClassObject(knows);
+    ASSERT_LT(holder.Size(), knows->Serialize().size());
+    holder.Write(file, 0);
+
+    ts::ClassObject read_class;
+    read_class.Read(file, 0);
+    ASSERT_EQ(read_class.GetClass()->Serialize(), knows->Serialize());
+    ASSERT_EQ(read_class.GetClass()->GetFingerprint(), knows->GetFingerprint());
+    ASSERT_EQ(read_class.GetClass()->GetKind(), ts::kRelationKind);
+}
+
+TEST(TypeSystem, Vector) {
+    ASSERT_EQ(static_cast<float>(util::Half(1.5f)), 1.5f);
+    ASSERT_EQ(static_cast<float>(util::Half(-0.25f)), -0.25f);
+    ASSERT_EQ(static_cast<float>(util::Half(65504.f)), 65504.f);
+    ASSERT_EQ(util::Half(1e6f).Bits(), 0x7C00);
+    ASSERT_EQ(static_cast<float>(util::Half(std::ldexp(1.f, -24))), std::ldexp(1.f, -24));
+
+    auto embedding = ts::NewVectorClass<float, 4>("embedding");
+    ASSERT_EQ(embedding->Size(), 4 * sizeof(float));
+    auto document =
+        ts::NewClass<ts::StructClass>("document", ts::NewClass<ts::StringClass>("title"),
+                                      ts::NewVectorClass<util::Half, 3>("embedding"));
+
+    auto file = util::MakePtr<mem::File>("test.data");
+    file->Clear();
+    ts::ClassObject(document).Write(file, 0);
+    ts::ClassObject read_class;
+    read_class.Read(file, 0);
+    ASSERT_EQ(read_class.GetClass()->Serialize(), document->Serialize());
+    ASSERT_EQ(read_class.GetClass()->GetFingerprint(), document->GetFingerprint());
+
+    auto values = std::vector<float>{1, 2, 3, 4};
+    auto vector = ts::New<ts::Vector<float>>(embedding, values);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(vector->Values().data()) % util::kSimdAlignment, 0);
+    ASSERT_TRUE(std::ranges::equal(vector->Values(), values));
+    ASSERT_THROW(std::ignore = ts::New<ts::Vector<float>>(embedding, std::vector<float>{1, 2}),
+                 error::BadArgument);
+    ASSERT_THROW(std::ignore = ts::New<ts::Vector<int8_t>>(embedding, std::vector<int8_t>{1}),
+                 error::TypeError);
+
+    auto halves = std::array{util::Half(0.5f), util::Half(1.f), util::Half(2.f)};
+    auto node = ts::New<ts::Struct>(document, "Greg", halves);
+    node->Write(file, 0);
+    auto read_node = ts::ReadNew<ts::Struct>(document, file, 0);
+    ASSERT_EQ(read_node->ToString(), node->ToString());
+}
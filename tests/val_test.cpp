@@ -146,4 +146,197 @@ TEST(ValNodeStorage, IdLogic) {
         std::cerr << it.GetRealOffset() << std::endl;
         return true;
     });
-}
\ No newline at end of file
+}
+TEST(ValNodeStorage, Compaction) {
+    auto coords =
+        ts::NewClass<ts::StructClass>("coords", ts::NewClass<ts::PrimitiveClass<double>>("lat"),
+                                      ts::NewClass<ts::PrimitiveClass<double>>("lon"));
+    auto name = ts::NewClass<ts::StringClass>("name");
+
+    auto file = util::MakePtr<mem::File>("test.data");
+    {
+        auto database = db::Database(file, db::OpenMode::kWrite);
+        database.AddClass(coords);
+        database.AddClass(name);
+
+        for (size_t i = 0; i < 2000; ++i) {
+            database.AddNode(ts::New<ts::Struct>(coords, 13., 46.));
+            database.AddNode(ts::New<ts::String>(name, "Greg"));
+        }
+
+        auto size = file->GetSize();
+        database.RemoveNodesIf(coords, db::kAll);
+        // Coords took the half of the pages, the superblock stays
+        ASSERT_LE(file->GetSize() - mem::kPagetableOffset, (size - mem::kPagetableOffset) / 2);
+    }
+
+    auto database = db::Database(file, db::OpenMode::kRead);
+    size_t count = 0;
+    database.VisitNodes(name, db::kAll, [&count](auto it) {
+        ASSERT_EQ(it->template Data<ts::String>()->Value(), "Greg");
+        ++count;
+    });
+    ASSERT_EQ(count, 2000);
+}
+
+TEST(ValNodeStorage, CompactionToFirstPage) {
+    auto coords =
+        ts::NewClass<ts::StructClass>("coords", ts::NewClass<ts::PrimitiveClass<double>>("lat"),
+                                      ts::NewClass<ts::PrimitiveClass<double>>("lon"));
+    auto name = ts::NewClass<ts::StringClass>("name");
+
+    auto file = util::MakePtr<mem::File>("test.data");
+    auto database = db::Database(file, db::OpenMode::kWrite);
+    database.AddClass(name);
+    database.AddClass(coords);
+    for (size_t i = 0; i < 1000; ++i) {
+        database.AddNode(ts::New<ts::Struct>(coords, 13., 46.));
+    }
+
+    // Pages of the removed class are the first ones, so the last data page is moved to the zero one
+    database.RemoveClass(name);
+    database.Compact();
+    bool first_page = false;
+    database.VisitNodes(coords, db::kAll, [&](db::ValNodeIterator it) {
+        first_page |= mem::GetIndex(it.GetRealOffset(), file) == 0;
+    });
+    ASSERT_TRUE(first_page);
+
+    for (ts::ObjectId id = 0; id < 1000; ++id) {
+        ASSERT_TRUE(database.FindNode(coords, id).has_value());
+    }
+}
+
+TEST(ValNodeStorage, PageSize) {
+    auto coords =
+        ts::NewClass<ts::StructClass>("coords", ts::NewClass<ts::PrimitiveClass<double>>("lat"),
+                                      ts::NewClass<ts::PrimitiveClass<double>>("lon"));
+    auto file = util::MakePtr<mem::File>("test.data");
+    {
+        auto database = db::Database(file, db::OpenMode::kWrite, 16384);
+        database.AddClass(coords);
+        for (size_t i = 0; i < 1000; ++i) {
+            database.AddNode(ts::New<ts::Struct>(coords, 13., 46.));
+        }
+    }
+    ASSERT_THROW(db::Database(file, db::OpenMode::kWrite, 1000), error::BadArgument);
+
+    auto database = db::Database(file, db::OpenMode::kDefault, 4096);
+    ASSERT_EQ(file->GetPageSize(), 16384);
+    size_t count = 0;
+    database.VisitNodes(coords, db::kAll, [&count](auto) { ++count; });
+    ASSERT_EQ(count, 1000);
+}
+
+TEST(ValNodeStorage, FormatVersion) {
+    auto file = util::MakePtr<mem::File>("test.data");
+    {
+        auto database = db::Database(file, db::OpenMode::kWrite);
+    }
+    file->Write<mem::GlobalMagic>(mem::kLegacyMagic, 0);
+    ASSERT_THROW(db::Database(file, db::OpenMode::kRead), error::StructureError);
+    ASSERT_THROW(db::Database(file, db::OpenMode::kDefault), error::StructureError);
+    ASSERT_EQ(file->Read<mem::GlobalMagic>(0), mem::kLegacyMagic);
+
+    file->Write<mem::GlobalMagic>(mem::kMagic + 1, 0);
+    ASSERT_THROW(db::Database(file, db::OpenMode::kRead), error::StructureError);
+    file->Write<mem::GlobalMagic>(mem::kMagic, 0);
+    ASSERT_NO_THROW(db::Database(file, db::OpenMode::kRead));
+}
+
+TEST(ValNodeStorage, CompactLayout) {
+    auto value = ts::NewClass<ts::PrimitiveClass<int>>("value");
+    auto default_file = util::MakePtr<mem::File>("test.data");
+    auto compact_file = util::MakePtr<mem::File>("compact.data");
+    {
+        auto default_database = db::Database(default_file, db::OpenMode::kWrite);
+        auto compact_database = db::Database(compact_file, db::OpenMode::kWrite);
+        default_database.AddClass(value);
+        compact_database.AddClass(value, mem::NodeLayout::kCompact);
+        ASSERT_THROW(compact_database.AddClass(ts::NewClass<ts::StringClass>("name"),
+                                               mem::NodeLayout::kCompact),
+                     error::BadArgument);
+
+        for (int i = 0; i < 10000; ++i) {
+            default_database.AddNode(ts::New<ts::Primitive<int>>(value, i));
+            compact_database.AddNode(ts::New<ts::Primitive<int>>(value, i));
+        }
+        ASSERT_LT(compact_file->GetSize() * 3, default_file->GetSize());
+
+        compact_database.RemoveNodesIf(value, [](db::ValNodeIterator it) {
+            return it->Data<ts::Primitive<int>>()->Value() % 2 == 0;
+        });
+    }
+
+    auto database = db::Database(compact_file, db::OpenMode::kRead);
+    std::set<ts::ObjectId> ids;
+    database.VisitNodes(value, db::kAll, [&ids](db::ValNodeIterator it) {
+        ASSERT_EQ(it->Data<ts::Primitive<int>>()->Value() % 2, 1);
+        ASSERT_EQ(it.Id(), it->Id());
+        ids.insert(it.Id());
+    });
+    ASSERT_EQ(ids.size(), 5000);
+}
+
+TEST(ValNodeStorage, SlotReuse) {
+    auto value = ts::NewClass<ts::PrimitiveClass<int>>("value");
+    auto file = util::MakePtr<mem::File>("test.data");
+    auto database = db::Database(file, db::OpenMode::kWrite);
+    database.AddClass(value);
+
+    for (int i = 0; i < 10000; ++i) {
+        database.AddNode(ts::New<ts::Primitive<int>>(value, i));
+    }
+    database.RemoveNodesIf(value, [](db::ValNodeIterator it) {
+        return it->Data<ts::Primitive<int>>()->Value() % 3 != 0;
+    });
+    auto size = file->GetSize();
+
+    for (int i = 0; i < 6000; ++i) {
+        database.AddNode(ts::New<ts::Primitive<int>>(value, -1));
+    }
+    // Only the id table grows, removed ids are never given again
+    auto table_size = 6000 * sizeof(db::NodeLocation) / mem::kDefaultPageSize + 1;
+    ASSERT_LE(file->GetSize(), size + table_size * mem::kDefaultPageSize);
+
+    size_t count = 0;
+    std::set<ts::ObjectId> ids;
+    database.VisitNodes(value, db::kAll, [&](db::ValNodeIterator it) {
+        ids.insert(it->Id());
+        ++count;
+    });
+    ASSERT_EQ(count, 3334 + 6000);
+    ASSERT_EQ(ids.size(), count);
+}
+
+TEST(ValNodeStorage, FreeSpaceMap) {
+    auto file = util::MakePtr<mem::File>("test.data");
+    auto coords =
+        ts::NewClass<ts::StructClass>("coords", ts::NewClass<ts::PrimitiveClass<int>>("x"));
+    {
+        auto database = db::Database(file, db::OpenMode::kWrite);
+        database.AddClass(coords);
+    }
+    auto alloc = util::MakePtr<mem::PageAllocator>(file);
+    auto class_storage = db::ClassStorage(alloc);
+    auto header = mem::ClassHeader(class_storage.FindClass(coords).value());
+    auto read_header = [&] { return mem::ClassHeader(header).ReadClassHeader(file); };
+    auto map = mem::FreeSpaceMap("Free_Space_Map", alloc, header.GetFreeSpaceSentinelOffset(file),
+                                 header.GetFreeSpaceDirectorySentinelOffset(file));
+
+    // Full pages and the chunks before the used one get no map pages
+    map.Update(7, 0);
+    ASSERT_EQ(read_header().free_space_pages_count_, 0);
+    map.Update(100000, 1000);
+    map.Update(100001, 2000);
+    ASSERT_EQ(read_header().free_space_pages_count_, 1);
+    ASSERT_EQ(map.Find(1500), 100001);
+    ASSERT_EQ(map.Find(500), 100000);
+    ASSERT_FALSE(map.Find(3000).has_value());
+
+    map.Update(100001, 0);
+    ASSERT_EQ(map.Find(1500), std::nullopt);
+    map.Drop();
+    ASSERT_EQ(read_header().free_space_pages_count_, 0);
+    ASSERT_EQ(read_header().free_space_directory_pages_count_, 0);
+}
@@ -64,4 +64,103 @@ TEST(VarNodeStorage, NodeDeletionWithDeallocation) {
     database.RemoveNodesIf(
         name, [](db::VarNodeIterator it) { return it->Data<ts::String>()->Value()[0] == 'G'; });
     database.PrintNodesIf(name, db::kAll);
-}
\ No newline at end of file
+}
+TEST(VarNodeStorage, Overflow) {
+    auto name = ts::NewClass<ts::StringClass>("name");
+    auto file = util::MakePtr<mem::File>("test.data");
+    auto text = std::string(3 * mem::kDefaultPageSize, 'a');
+    for (size_t i = 0; i < text.size(); i += 7) {
+        text[i] = static_cast<char>('a' + i % 26);
+    }
+
+    auto database = db::Database(file, db::OpenMode::kWrite);
+    database.AddClass(name);
+    auto size = file->GetSize();
+    for (size_t i = 0; i < 10; ++i) {
+        database.AddNode(ts::New<ts::String>(name, "Greg"));
+        database.AddNode(ts::New<ts::String>(name, text));
+    }
+
+    size_t big = 0;
+    database.VisitNodes(name, db::kAll, [&](db::VarNodeIterator it) {
+        if (it.IsOverflowed()) {
+            ASSERT_EQ(it.ReadStringPrefix(10), text.substr(0, 10));
+            ASSERT_EQ(it->Data<ts::String>()->Value(), text);
+            ++big;
+        } else {
+            ASSERT_EQ(it->Data<ts::String>()->Value(), "Greg");
+        }
+    });
+    ASSERT_EQ(big, 10);
+
+    database.RemoveNodesIf(name, [](db::VarNodeIterator it) { return it.IsOverflowed(); });
+    // Data page, free space map with its directory and id table are left
+    ASSERT_LE(file->GetSize(), size + 4 * mem::kDefaultPageSize);
+}
+
+TEST(VarNodeStorage, SlotReuse) {
+    auto name = ts::NewClass<ts::StringClass>("name");
+    auto file = util::MakePtr<mem::File>("test.data");
+    auto text = std::string(2 * mem::kDefaultPageSize, 'a');
+
+    auto database = db::Database(file, db::OpenMode::kWrite);
+    database.AddClass(name);
+    for (size_t i = 0; i < 40; ++i) {
+        database.AddNode(ts::New<ts::String>(name, "Gregory"));
+        database.AddNode(ts::New<ts::String>(name, "Hyperb0rean"));
+    }
+    database.AddNode(ts::New<ts::String>(name, text));
+    auto size = file->GetSize();
+
+    database.RemoveNodesIf(
+        name, [](db::VarNodeIterator it) { return it.ReadStringPrefix(1) == "G"; });
+    // Longer values fill the holes, so the page is compacted with the overflowed value in it
+    for (size_t i = 0; i < 30; ++i) {
+        database.AddNode(ts::New<ts::String>(name, "Hyperb0rean"));
+    }
+    ASSERT_EQ(file->GetSize(), size);
+
+    size_t count = 0;
+    database.VisitNodes(name, db::kAll, [&](db::VarNodeIterator it) {
+        if (it.IsOverflowed()) {
+            ASSERT_EQ(it->Data<ts::String>()->Value(), text);
+        } else {
+            ASSERT_EQ(it->Data<ts::String>()->Value(), "Hyperb0rean");
+            ++count;
+        }
+    });
+    ASSERT_EQ(count, 70);
+
+    database.RemoveNodesIf(name, db::kAll);
+    database.Compact();
+    ASSERT_LE(file->GetSize(), size - 2 * static_cast<mem::Offset>(mem::kDefaultPageSize));
+}
+
+TEST(VarNodeStorage, FreeSpaceMap) {
+    auto name = ts::NewClass<ts::StringClass>("name");
+    auto file = util::MakePtr<mem::File>("test.data");
+
+    auto database = db::Database(file, db::OpenMode::kWrite);
+    database.AddClass(name);
+    for (size_t i = 0; i < 500; ++i) {
+        database.AddNode(ts::New<ts::String>(name, "Gregory"));
+        database.AddNode(ts::New<ts::String>(name, "Hyperb0rean"));
+    }
+    auto size = file->GetSize();
+
+    // Holes are spread over all pages, not only the back one
+    for (size_t round = 0; round < 5; ++round) {
+        database.RemoveNodesIf(
+            name, [](db::VarNodeIterator it) { return it.ReadStringPrefix(1) == "G"; });
+        for (size_t i = 0; i < 400; ++i) {
+            database.AddNode(ts::New<ts::String>(name, "Gregory"));
+        }
+    }
+    // Only the id table grows, removed ids are never given again
+    auto table_size = 5 * 400 * sizeof(db::NodeLocation) / mem::kDefaultPageSize + 1;
+    ASSERT_LE(file->GetSize(), size + table_size * mem::kDefaultPageSize);
+
+    size_t count = 0;
+    database.VisitNodes(name, db::kAll, [&count](db::VarNodeIterator) { ++count; });
+    ASSERT_EQ(count, 900);
+}